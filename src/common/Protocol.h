@@ -1,9 +1,12 @@
 #pragma once
 
 #include <windows.h>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <atomic>
 #include <stdexcept>
+#include <string>
 #include <functional>
 
 #ifndef _OPENVR_API
@@ -11,7 +14,7 @@
 #endif
 
 #define OPENVR_SPACECALIBRATOR_PIPE_NAME "\\\\.\\pipe\\OpenVRSpaceCalibratorDriver"
-#define OPENVR_SPACECALIBRATOR_SHMEM_NAME "OpenVRSpaceCalibratorPoseMemoryV1"
+#define OPENVR_SPACECALIBRATOR_SHMEM_NAME "OpenVRSpaceCalibratorPoseMemoryV5"
 
 #ifdef _OPENVR_API 
 
@@ -92,7 +95,7 @@ namespace vr {
 
 namespace protocol
 {
-	const uint32_t Version = 4;
+	const uint32_t Version = 5;
 
 	enum RequestType
 	{
@@ -151,23 +154,29 @@ namespace protocol
 		bool lerp;
 		bool quash;
 
+		/**
+		 * Seconds by which the device's poses lag behind what their poseTimeOffset claims, e.g. as measured
+		 * against the reference tracking system. Added to the pose age so that SteamVR predicts that much further.
+		 */
+		double predictionOffset;
+
 		SetDeviceTransform(uint32_t id, bool enabled) :
-			openVRID(id), enabled(enabled), updateTranslation(false), updateRotation(false), updateScale(false), translation({}), rotation({1,0,0,0}), scale(1), lerp(false), quash(false) { }
+			openVRID(id), enabled(enabled), updateTranslation(false), updateRotation(false), updateScale(false), translation({}), rotation({1,0,0,0}), scale(1), lerp(false), quash(false), predictionOffset(0) { }
 
 		SetDeviceTransform(uint32_t id, bool enabled, vr::HmdVector3d_t translation) :
-			openVRID(id), enabled(enabled), updateTranslation(true), updateRotation(false), updateScale(false), translation(translation), rotation({ 1,0,0,0 }), scale(1), lerp(false), quash(false) { }
+			openVRID(id), enabled(enabled), updateTranslation(true), updateRotation(false), updateScale(false), translation(translation), rotation({ 1,0,0,0 }), scale(1), lerp(false), quash(false), predictionOffset(0) { }
 
 		SetDeviceTransform(uint32_t id, bool enabled, vr::HmdQuaternion_t rotation) :
-			openVRID(id), enabled(enabled), updateTranslation(false), updateRotation(true), updateScale(false), translation({}), rotation(rotation), scale(1), lerp(false), quash(false) { }
+			openVRID(id), enabled(enabled), updateTranslation(false), updateRotation(true), updateScale(false), translation({}), rotation(rotation), scale(1), lerp(false), quash(false), predictionOffset(0) { }
 
 		SetDeviceTransform(uint32_t id, bool enabled, double scale) :
-			openVRID(id), enabled(enabled), updateTranslation(false), updateRotation(false), updateScale(true), translation({}), rotation({ 1,0,0,0 }), scale(scale), lerp(false), quash(false) { }
+			openVRID(id), enabled(enabled), updateTranslation(false), updateRotation(false), updateScale(true), translation({}), rotation({ 1,0,0,0 }), scale(scale), lerp(false), quash(false), predictionOffset(0) { }
 
 		SetDeviceTransform(uint32_t id, bool enabled, vr::HmdVector3d_t translation, vr::HmdQuaternion_t rotation) :
-			openVRID(id), enabled(enabled), updateTranslation(true), updateRotation(true), updateScale(false), translation(translation), rotation(rotation), scale(1), lerp(false), quash(false) { }
+			openVRID(id), enabled(enabled), updateTranslation(true), updateRotation(true), updateScale(false), translation(translation), rotation(rotation), scale(1), lerp(false), quash(false), predictionOffset(0) { }
 
 		SetDeviceTransform(uint32_t id, bool enabled, vr::HmdVector3d_t translation, vr::HmdQuaternion_t rotation, double scale) :
-			openVRID(id), enabled(enabled), updateTranslation(true), updateRotation(true), updateScale(true), translation(translation), rotation(rotation), scale(scale), lerp(false), quash(false) { }
+			openVRID(id), enabled(enabled), updateTranslation(true), updateRotation(true), updateScale(true), translation(translation), rotation(rotation), scale(scale), lerp(false), quash(false), predictionOffset(0) { }
 	};
 
 	struct Request
@@ -196,6 +205,29 @@ namespace protocol
 		Response(ResponseType type) : type(type), protocol({}) { }
 	};
 
+	/*
+	 * Poses the driver reports, shared with the overlay.
+	 *
+	 * Every pose goes into a ring of CompactPose records, one cache line each, with the pose already converted to
+	 * world space. A ring of full AugmentedPose records is only written while a reader has asked for it with
+	 * RequestFullPoses(). Both rings work the same way: writers claim a record number with a single fetch_add and
+	 * fill in the slot it maps to, so they never wait on each other or on readers. Each slot has a sequence number
+	 * (a seqlock), kept in an array beside the records so that those stay densely packed. It is odd while record n
+	 * is being written, and 2 * (n + 1) once it is complete. A record that is still being written is left for the
+	 * next read, and one that was overwritten (because the reader fell too far behind) is skipped and counted in
+	 * Overruns(). ReadNewPoses() and ReadNewFullPoses() copy each record out and check it against its sequence
+	 * number before handing it over, so callbacks never see a torn record. Compact records can also be read in
+	 * place, in batches of up to two contiguous runs; a reader never starts more than half a ring behind, so the
+	 * driver can only reach them again after that many more poses, which a single look at the ring index detects
+	 * once the batch is done.
+	 *
+	 * Readers that would rather block than poll can arm a wakeup: the driver then signals a named event, once, at
+	 * the first pose of a watched device or the first pose a given interval after arming, whichever comes first.
+	 *
+	 * Next to the rings, a table holds each device's newest full pose under the same kind of seqlock, so that
+	 * reading the current pose of a device doesn't need to walk a ring. Each device's poses come from a single
+	 * driver thread, so its table slot only ever has one writer.
+	 */
 	class DriverPoseShmem {
 	public:
 		struct AugmentedPose {
@@ -203,21 +235,271 @@ namespace protocol
 			int deviceId;
 			vr::DriverPose_t pose;
 		};
+
+		/*
+		 * sampleTime is the QueryPerformanceCounter tick the pose describes, with its poseTimeOffset already
+		 * applied. Position, rotation (w, x, y, z) and both velocities are in world space.
+		 */
+		struct CompactPose {
+			int64_t sampleTime;
+			float position[3];
+			float rotation[4];
+			float velocity[3];
+			float angularVelocity[3];
+			uint8_t deviceId;
+			uint8_t flags;
+			uint8_t reserved[2];
+		};
+		static_assert(sizeof(CompactPose) == 64, "CompactPose should fill exactly one cache line");
+
+		static const uint8_t CompactPoseValid = 1;
+		static const uint8_t CompactDeviceConnected = 2;
+
+		/*
+		 * New compact records, read in place in the shared segment: first[0 .. firstCount), then
+		 * second[0 .. secondCount), which is only non-empty when the run wraps around the end of the ring. They
+		 * are record numbers [begin, end); `end` is where the next read starts.
+		 */
+		struct PoseBatch {
+			const CompactPose* first = nullptr;
+			size_t firstCount = 0;
+			const CompactPose* second = nullptr;
+			size_t secondCount = 0;
+			uint64_t begin = 0, end = 0;
+
+			size_t Size() const { return firstCount + secondCount; }
+		};
+
 	private:
 		static const uint32_t SYNC_ACTIVE_POSE_B = 0x80000000;
 		static const uint32_t BUFFERED_SAMPLES = 64 * 1024;
+		static const uint32_t BUFFERED_FULL_SAMPLES = 16 * 1024;
+		// A writer holds a latest pose slot for one copy; one that stays odd for longer belongs to a driver that died.
+		static const int LATEST_POSE_READ_ATTEMPTS = 256;
+
+		template<typename Record, uint32_t Size>
+		struct Ring {
+			std::atomic<uint64_t> index; // records claimed so far
+			std::atomic<uint64_t> sequence[Size];
+			alignas(64) Record records[Size];
+		};
+
+		// Where a reader is in a ring
+		struct Cursor {
+			uint64_t next = 0;
+			uint64_t overruns = 0;
+		};
+
+		struct alignas(64) LatestPoseSlot {
+			std::atomic<uint64_t> sequence; // odd while being written, 0 if the device never reported a pose
+			AugmentedPose pose;
+		};
+
+		struct Wakeup {
+			std::atomic<int64_t> armedAt; // QPC time the reader armed the wakeup, 0 while it isn't armed
+			std::atomic<int64_t> interval; // QPC ticks after arming from which any pose signals; negative for never
+			std::atomic<uint64_t> watchedDevices; // a bit per device whose poses signal right away
+		};
+		static_assert(vr::k_unMaxTrackedDeviceCount <= 64, "watchedDevices needs a bit per device");
 
 		struct ShmemData {
-			std::atomic<uint64_t> index;
-			AugmentedPose poses[BUFFERED_SAMPLES];
+			std::atomic<uint32_t> fullPosesRequested;
+			Wakeup wakeup;
+			Ring<CompactPose, BUFFERED_SAMPLES> compact;
+			Ring<AugmentedPose, BUFFERED_FULL_SAMPLES> full;
+			LatestPoseSlot latest[vr::k_unMaxTrackedDeviceCount];
 		};
-		
+
+		static uint64_t WritingSequence(uint64_t record) { return record * 2 + 1; }
+		static uint64_t CompleteSequence(uint64_t record) { return record * 2 + 2; }
+
+		template<typename Record, uint32_t Size, typename F>
+		static void Write(Ring<Record, Size>& ring, const F& fill) {
+			const uint64_t record = ring.index.fetch_add(1, std::memory_order_acq_rel);
+			const uint32_t slot = (uint32_t)(record % Size);
+
+			ring.sequence[slot].store(WritingSequence(record), std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			fill(ring.records[slot]);
+
+			ring.sequence[slot].store(CompleteSequence(record), std::memory_order_release);
+		}
+
+		// Moves a reader that fell more than half a ring behind up to there, and returns the records claimed so far.
+		template<typename Record, uint32_t Size>
+		static uint64_t CatchUp(const Ring<Record, Size>& ring, Cursor& cursor) {
+			uint64_t cur_index = ring.index.load(std::memory_order_acquire);
+			if (cur_index < cursor.next) {
+				// The driver restarted with a fresh segment
+				cursor.next = cur_index;
+			} else if (cur_index - cursor.next > Size / 2) {
+				cursor.overruns += cur_index - Size / 2 - cursor.next;
+				cursor.next = cur_index - Size / 2;
+			}
+			return cur_index;
+		}
+
+		// Calls cb(record) on a checked copy of each new record, and returns how many were lost to overruns.
+		template<typename Record, uint32_t Size, typename F>
+		static uint64_t Read(const Ring<Record, Size>& ring, Cursor& cursor, const F& cb) {
+			const uint64_t overruns = cursor.overruns;
+			const uint64_t cur_index = CatchUp(ring, cursor);
+
+			Record record;
+			while (cursor.next < cur_index) {
+				const uint32_t slot = (uint32_t)(cursor.next % Size);
+
+				const uint64_t sequence = ring.sequence[slot].load(std::memory_order_acquire);
+				if (sequence < CompleteSequence(cursor.next)) {
+					// Still being written; pick it up next time
+					break;
+				}
+
+				bool intact = false;
+				if (sequence == CompleteSequence(cursor.next)) {
+					memcpy(&record, &ring.records[slot], sizeof record);
+					std::atomic_thread_fence(std::memory_order_acquire);
+					intact = ring.sequence[slot].load(std::memory_order_relaxed) == sequence;
+				}
+
+				cursor.next++;
+				if (intact) {
+					cb(record);
+				} else {
+					cursor.overruns++;
+				}
+			}
+
+			return cursor.overruns - overruns;
+		}
+
+		/*
+		 * Finds the run of complete records after the cursor, in place. A record that was already overwritten is
+		 * skipped if it starts the run and ends it otherwise, so the next read skips it.
+		 */
+		template<typename Record, uint32_t Size, typename Batch>
+		static void Claim(const Ring<Record, Size>& ring, Cursor& cursor, Batch& batch) {
+			const uint64_t cur_index = CatchUp(ring, cursor);
+
+			uint64_t end = cursor.next;
+			while (end < cur_index) {
+				const uint64_t sequence = ring.sequence[end % Size].load(std::memory_order_acquire);
+				if (sequence == CompleteSequence(end)) {
+					end++;
+				} else if (sequence > CompleteSequence(end) && end == cursor.next) {
+					cursor.overruns++;
+					cursor.next = ++end;
+				} else {
+					break;
+				}
+			}
+
+			const uint32_t slot = (uint32_t)(cursor.next % Size);
+			const size_t count = (size_t)(end - cursor.next);
+
+			batch.begin = cursor.next;
+			batch.end = end;
+			batch.first = &ring.records[slot];
+			batch.firstCount = count < Size - slot ? count : Size - slot;
+			batch.second = &ring.records[0];
+			batch.secondCount = count - batch.firstCount;
+		}
+
+		/*
+		 * Moves the cursor past a claimed batch. Record n is only overwritten once record n + Size is claimed, so
+		 * one look at the ring index tells how many records from the front of the batch may have changed while
+		 * they were being read; those are counted as overruns and returned.
+		 */
+		template<typename Record, uint32_t Size, typename Batch>
+		static size_t Release(const Ring<Record, Size>& ring, Cursor& cursor, const Batch& batch) {
+			std::atomic_thread_fence(std::memory_order_acquire);
+			const uint64_t cur_index = ring.index.load(std::memory_order_relaxed);
+
+			size_t overwritten = 0;
+			if (cur_index > batch.begin + Size) {
+				const uint64_t reused = cur_index - Size;
+				overwritten = (size_t)((reused < batch.end ? reused : batch.end) - batch.begin);
+			}
+
+			cursor.overruns += overwritten;
+			if (cursor.next == batch.begin) cursor.next = batch.end;
+			return overwritten;
+		}
+
+		static vr::HmdQuaternion_t Multiply(const vr::HmdQuaternion_t& lhs, const vr::HmdQuaternion_t& rhs) {
+			return {
+				(lhs.w * rhs.w) - (lhs.x * rhs.x) - (lhs.y * rhs.y) - (lhs.z * rhs.z),
+				(lhs.w * rhs.x) + (lhs.x * rhs.w) + (lhs.y * rhs.z) - (lhs.z * rhs.y),
+				(lhs.w * rhs.y) + (lhs.y * rhs.w) + (lhs.z * rhs.x) - (lhs.x * rhs.z),
+				(lhs.w * rhs.z) + (lhs.z * rhs.w) + (lhs.x * rhs.y) - (lhs.y * rhs.x)
+			};
+		}
+
+		// Rotates v by q, as v + 2w (q x v) + 2 q x (q x v) with q the vector part.
+		static void Rotate(const vr::HmdQuaternion_t& q, const double(&v)[3], float(&out)[3]) {
+			const double t[3] = {
+				2 * (q.y * v[2] - q.z * v[1]),
+				2 * (q.z * v[0] - q.x * v[2]),
+				2 * (q.x * v[1] - q.y * v[0]),
+			};
+			out[0] = (float)(v[0] + q.w * t[0] + (q.y * t[2] - q.z * t[1]));
+			out[1] = (float)(v[1] + q.w * t[1] + (q.z * t[0] - q.x * t[2]));
+			out[2] = (float)(v[2] + q.w * t[2] + (q.x * t[1] - q.y * t[0]));
+		}
+
+		void Compact(int index, LARGE_INTEGER sampleTime, const vr::DriverPose_t& pose, CompactPose& out) const {
+			const vr::HmdQuaternion_t& worldFromDriver = pose.qWorldFromDriverRotation;
+
+			out.sampleTime = sampleTime.QuadPart + (int64_t)llround(pose.poseTimeOffset * qpcFrequency);
+
+			Rotate(worldFromDriver, pose.vecPosition, out.position);
+			for (int i = 0; i < 3; i++) {
+				out.position[i] += (float)pose.vecWorldFromDriverTranslation[i];
+			}
+
+			const vr::HmdQuaternion_t rotation = Multiply(worldFromDriver, pose.qRotation);
+			out.rotation[0] = (float)rotation.w;
+			out.rotation[1] = (float)rotation.x;
+			out.rotation[2] = (float)rotation.y;
+			out.rotation[3] = (float)rotation.z;
+
+			Rotate(worldFromDriver, pose.vecVelocity, out.velocity);
+			Rotate(worldFromDriver, pose.vecAngularVelocity, out.angularVelocity);
+
+			out.deviceId = (uint8_t)index;
+			out.flags = (pose.poseIsValid ? CompactPoseValid : 0) | (pose.deviceIsConnected ? CompactDeviceConnected : 0);
+			out.reserved[0] = out.reserved[1] = 0;
+		}
+
+		void Wake(int index, int64_t now) {
+			Wakeup& wakeup = pData->wakeup;
+
+			const int64_t armedAt = wakeup.armedAt.load(std::memory_order_relaxed);
+			if (armedAt == 0 || hWakeupEvent == nullptr) return;
+
+			if (!((wakeup.watchedDevices.load(std::memory_order_relaxed) >> index) & 1)) {
+				const int64_t interval = wakeup.interval.load(std::memory_order_relaxed);
+				if (interval < 0 || now - armedAt < interval) return;
+			}
+
+			// Several driver threads may get here at once; only one of them signals
+			int64_t expected = armedAt;
+			if (wakeup.armedAt.compare_exchange_strong(expected, 0, std::memory_order_acq_rel)) {
+				SetEvent(hWakeupEvent);
+			}
+		}
+
+		static std::string WakeupEventName(LPCSTR segment_name) {
+			return std::string(segment_name) + "Wakeup";
+		}
+
 	private:
 		HANDLE hMapFile;
+		HANDLE hWakeupEvent;
 		ShmemData* pData;
-		uint64_t cursor;
-
-		AugmentedPose lastPose[vr::k_unMaxTrackedDeviceCount] = {0};
+		Cursor compactCursor, fullCursor;
+		double qpcFrequency;
 
 		std::string LastErrorString(DWORD lastError)
 		{
@@ -243,8 +525,12 @@ namespace protocol
 
 		DriverPoseShmem() {
 			hMapFile = INVALID_HANDLE_VALUE;
+			hWakeupEvent = nullptr;
 			pData = nullptr;
-			cursor = 0;
+
+			LARGE_INTEGER frequency;
+			QueryPerformanceFrequency(&frequency);
+			qpcFrequency = (double)frequency.QuadPart;
 		}
 
 		~DriverPoseShmem() {
@@ -254,6 +540,8 @@ namespace protocol
 		void Close() {
 			if (pData) UnmapViewOfFile(pData);
 			if (hMapFile) CloseHandle(hMapFile);
+			if (hWakeupEvent) CloseHandle(hWakeupEvent);
+			hWakeupEvent = nullptr;
 		}
 
 		bool Create(LPCSTR segment_name) {
@@ -278,6 +566,9 @@ namespace protocol
 				sizeof(ShmemData)
 			));
 
+			// Readers work without it, by polling
+			hWakeupEvent = CreateEventA(NULL, FALSE, FALSE, WakeupEventName(segment_name).c_str());
+
 			return !!pData;
 		}
 
@@ -307,56 +598,153 @@ namespace protocol
 				throw std::runtime_error("Failed to map pose data shared memory segment: " + LastErrorString(GetLastError()));
 			}
 
+			hWakeupEvent = OpenEventA(SYNCHRONIZE, FALSE, WakeupEventName(segment_name).c_str());
+
 			char tmp[256];
 			snprintf(tmp, sizeof tmp, "Opened shmem segment: %p\n", pData);
 			OutputDebugStringA(tmp);
 		}
 
-		void ReadNewPoses(std::function<void(AugmentedPose const&)> cb) {
+		// Records the reader lost because the driver had already overwritten them.
+		uint64_t Overruns() const {
+			return compactCursor.overruns + fullCursor.overruns;
+		}
+
+		/*
+		 * Claims the compact records written since the last read, without copying them out. The records stay valid
+		 * until the driver wraps around the ring onto them, which takes it half a ring of poses; finish with
+		 * EndReadPoses(), which says how many of them, from the front, may have been overwritten in the meantime.
+		 * As that is only known afterwards, callers that can't undo what they did with such records should use
+		 * ReadNewPoses() instead. Only one read can be in progress at a time.
+		 */
+		PoseBatch BeginReadPoses() {
 			if (!pData) throw std::runtime_error("Not open");
-			
-			uint64_t cur_index = pData->index.load(std::memory_order_acquire);
-			if (cur_index < cursor || cur_index - cursor > BUFFERED_SAMPLES / 2) {
-				if (cur_index < BUFFERED_SAMPLES / 2)
-					cursor = cur_index;
-				else
-					cursor = cur_index - BUFFERED_SAMPLES / 2;
-			}
 
-			while (cursor < cur_index) {
-				cb(pData->poses[cursor % BUFFERED_SAMPLES]);
-				cursor++;
-			}
+			PoseBatch batch;
+			Claim(pData->compact, compactCursor, batch);
+			return batch;
+		}
 
-			std::atomic_thread_fence(std::memory_order_release);
+		size_t EndReadPoses(const PoseBatch& batch) {
+			if (!pData) throw std::runtime_error("Not open");
+			return Release(pData->compact, compactCursor, batch);
 		}
 
-		bool GetPose(int index, vr::DriverPose_t& pose, LARGE_INTEGER *pSampleTime = NULL) {
-			ReadNewPoses([this](AugmentedPose const& pose) {
-				if (pose.pose.poseIsValid) {
-					this->lastPose[pose.deviceId] = pose;
+		/*
+		 * Calls cb(pose) on each new compact record, copied out and checked against its sequence number first; a
+		 * record is a single cache line, so the copy costs next to nothing. Returns how many records were lost
+		 * because the driver had already overwritten them.
+		 */
+		template<typename F>
+		uint64_t ReadNewPoses(const F& cb) {
+			if (!pData) throw std::runtime_error("Not open");
+			return Read(pData->compact, compactCursor, cb);
+		}
+
+		// Asks the driver to also write full records, for ReadNewFullPoses.
+		void RequestFullPoses(bool request) {
+			if (!pData) throw std::runtime_error("Not open");
+			pData->fullPosesRequested.store(request ? 1 : 0, std::memory_order_relaxed);
+		}
+
+		uint64_t ReadNewFullPoses(std::function<void(AugmentedPose const&)> cb) {
+			if (!pData) throw std::runtime_error("Not open");
+			return Read(pData->full, fullCursor, cb);
+		}
+
+		// Whether the driver can signal new poses; if not, readers have to poll.
+		bool HasWakeup() const {
+			return hWakeupEvent != nullptr;
+		}
+
+		/*
+		 * Makes the driver signal the wakeup event once: at the first pose of a device in watchedDevices (a bit per
+		 * device), or at the first pose of any device `interval` seconds or more from now (never, if negative).
+		 * Arm it before reading the new poses, so that none can slip in between the read and the wait.
+		 */
+		void ArmWakeup(double interval, uint64_t watchedDevices) {
+			if (!pData) throw std::runtime_error("Not open");
+
+			LARGE_INTEGER now;
+			QueryPerformanceCounter(&now);
+
+			Wakeup& wakeup = pData->wakeup;
+			wakeup.interval.store(interval < 0 ? -1 : (int64_t)(interval * qpcFrequency), std::memory_order_relaxed);
+			wakeup.watchedDevices.store(watchedDevices, std::memory_order_relaxed);
+			wakeup.armedAt.store(now.QuadPart > 0 ? now.QuadPart : 1, std::memory_order_release);
+		}
+
+		// Blocks until the driver signals the wakeup event, or for timeoutMs at most. Returns whether it was signalled.
+		bool WaitForWakeup(DWORD timeoutMs) {
+			if (!hWakeupEvent) return false;
+			return WaitForSingleObject(hWakeupEvent, timeoutMs) == WAIT_OBJECT_0;
+		}
+
+		// Copies out the newest pose the driver reported for a device. Returns false if there is none yet, or if the slot
+		// stays mid-write for LATEST_POSE_READ_ATTEMPTS tries, as it does when the driver died writing it.
+		bool GetLatestPose(int index, AugmentedPose& out) const {
+			if (!pData) throw std::runtime_error("Not open");
+			if (index < 0 || index >= vr::k_unMaxTrackedDeviceCount) return false;
+
+			const LatestPoseSlot& slot = pData->latest[index];
+			for (int attempt = 0; attempt < LATEST_POSE_READ_ATTEMPTS; attempt++) {
+				const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+				if (sequence == 0) return false;
+
+				if ((sequence & 1) == 0) {
+					memcpy(&out, &slot.pose, sizeof out);
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if (slot.sequence.load(std::memory_order_relaxed) == sequence) return true;
 				}
-			});
 
-			if (index >= 0 && index < vr::k_unMaxTrackedDeviceCount) {
-				pose = lastPose[index].pose;
-				if (pSampleTime) *pSampleTime = lastPose[index].sample_time;
-				return true;
+				YieldProcessor();
 			}
+
+			// Treated like a device that never reported a pose
+			return false;
+		}
+
+		bool GetPose(int index, vr::DriverPose_t& pose, LARGE_INTEGER *pSampleTime = NULL) {
+			AugmentedPose latest;
+			if (!GetLatestPose(index, latest)) return false;
+
+			pose = latest.pose;
+			if (pSampleTime) *pSampleTime = latest.sample_time;
+			return true;
 		}
 
 		void SetPose(int index, const vr::DriverPose_t& pose) {
-			if (index >= vr::k_unMaxTrackedDeviceCount) return;
+			if (index < 0 || index >= vr::k_unMaxTrackedDeviceCount) return;
 			if (pData == nullptr) return;
 
-			AugmentedPose augPose = {0};
-			augPose.deviceId = index;
-			augPose.pose = pose;
-			QueryPerformanceCounter(&augPose.sample_time);
+			LARGE_INTEGER sampleTime;
+			QueryPerformanceCounter(&sampleTime);
+
+			Write(pData->compact, [&](CompactPose& record) {
+				Compact(index, sampleTime, pose, record);
+			});
+
+			if (pData->fullPosesRequested.load(std::memory_order_relaxed)) {
+				Write(pData->full, [&](AugmentedPose& record) {
+					record.sample_time = sampleTime;
+					record.deviceId = index;
+					record.pose = pose;
+				});
+			}
+
+			LatestPoseSlot& latest = pData->latest[index];
+			const uint64_t sequence = latest.sequence.load(std::memory_order_relaxed);
+
+			latest.sequence.store(sequence + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			latest.pose.sample_time = sampleTime;
+			latest.pose.deviceId = index;
+			latest.pose.pose = pose;
+
+			latest.sequence.store(sequence + 2, std::memory_order_release);
 
-			uint64_t cur_index = pData->index.load(std::memory_order_relaxed) + 1;
-			pData->poses[cur_index % BUFFERED_SAMPLES] = augPose;
-			pData->index.store(cur_index, std::memory_order_release);
+			Wake(index, sampleTime.QuadPart);
 		}
 	};
 }
\ No newline at end of file
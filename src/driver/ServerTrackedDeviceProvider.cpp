@@ -202,6 +202,7 @@ void ServerTrackedDeviceProvider::SetDeviceTransform(const protocol::SetDeviceTr
 		tf.scale = newTransform.scale;
 
 	tf.quash = newTransform.quash;
+	tf.predictionOffset = newTransform.predictionOffset;
 }
 
 bool ServerTrackedDeviceProvider::HandleDevicePoseUpdated(uint32_t openVRID, vr::DriverPose_t &pose)
@@ -237,6 +238,9 @@ bool ServerTrackedDeviceProvider::HandleDevicePoseUpdated(uint32_t openVRID, vr:
 
 		BlendTransform(tf, deviceWorldPose);
 		ApplyTransform(tf, pose);
+
+		// The pose is older than the device claims; have SteamVR predict it further ahead.
+		pose.poseTimeOffset -= tf.predictionOffset;
 	}
 
 	return true;
@@ -65,6 +65,7 @@ private:
 		bool quash = false;
 		IsoTransform transform, targetTransform;
 		double scale;
+		double predictionOffset = 0.0;
 		LARGE_INTEGER lastPoll;
 		DeltaSize currentRate = DeltaSize::TINY;
 	};
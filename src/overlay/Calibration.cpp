@@ -4,9 +4,16 @@
 #include "Configuration.h"
 #include "IPCClient.h"
 #include "CalibrationCalc.h"
+#include "CalibrationFilter.h"
+#include "LatencyEstimator.h"
+#include "SampleIngest.h"
+#include "SolverWorker.h"
 #include "VRState.h"
 
+#include <atomic>
+#include <deque>
 #include <string>
+#include <thread>
 #include <vector>
 #include <iostream>
 
@@ -26,8 +33,77 @@ CalibrationContext CalCtx;
 IPCClient Driver;
 static protocol::DriverPoseShmem shmem;
 
+// A one-shot window with the coreset policy spreads over at least this many cells; see coresetCellLimit.
+static const size_t CoresetMinCells = 10;
+
+// One-shot calibration tries to finish early once it has this many samples, and again every interval after.
+static const size_t MinEarlyStopSamples = 20;
+static const size_t EarlyStopInterval = 10;
+
+// The driver wakes the run loop up once it has been producing poses for the update interval the calibration
+// wants, but no more often than ticks run; the wait times out every so often to check for shutdown.
+static const double PoseWakeupInterval = 0.05;
+static const DWORD PoseWakeupTimeoutMs = 500;
+
 namespace {
+	/*
+	 * Blocks on the driver's wakeup event on its own thread, and wakes the run loop up with an empty GLFW event
+	 * each time it fires, so that the loop doesn't have to poll for new poses.
+	 */
+	class PoseWakeup {
+	public:
+		~PoseWakeup() { Stop(); }
+
+		void Start() {
+			if (m_thread.joinable()) return;
+			m_shutdown = false;
+			m_thread = std::thread([this]() { ThreadMain(); });
+		}
+
+		void Stop() {
+			m_shutdown = true;
+			if (m_thread.joinable()) m_thread.join();
+		}
+
+		void SetInterval(double interval) { m_interval = interval; }
+
+	private:
+		void ThreadMain() {
+			while (!m_shutdown) {
+				shmem.ArmWakeup(m_interval, 0);
+				if (shmem.WaitForWakeup(PoseWakeupTimeoutMs)) {
+					glfwPostEmptyEvent();
+				}
+			}
+		}
+
+		std::thread m_thread;
+		std::atomic<bool> m_shutdown = false;
+		std::atomic<double> m_interval = PoseWakeupInterval;
+	};
+
 	CalibrationCalc calibration;
+	CalibrationFilter filter;
+	SolverWorker solver;
+
+	// Pairs the pose stream into samples; admitted samples wait here until the tick pushes them into the window.
+	SampleIngest ingest;
+	std::deque<Sample> ingested;
+
+	// Window size at which one-shot calibration next checks whether it has converged
+	size_t nextEarlyStopSamples = MinEarlyStopSamples;
+
+	// Measures how far the target system lags, from the same pose stream
+	LatencyEstimator latencyEstimator;
+	double timeLastLatencyUpdate = 0.0;
+
+	// Last estimate the filter pushed out to the profile
+	Eigen::AffineCompact3d filterPublished = Eigen::AffineCompact3d::Identity();
+
+	// Seconds per QueryPerformanceCounter tick, for the pose sample times
+	double qpcPeriod = 0.0;
+
+	PoseWakeup poseWakeup;
 
 	inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const double(&vector)[3]) {
 		vr::HmdQuaternion_t vectorQuat = { 0.0, vector[0], vector[1] , vector[2] };
@@ -127,35 +203,14 @@ namespace {
 		return ds;
 	}
 
-	Pose ConvertPose(const vr::DriverPose_t &driverPose) {
-		Eigen::Quaterniond driverToWorldQ(
-			driverPose.qWorldFromDriverRotation.w,
-			driverPose.qWorldFromDriverRotation.x,
-			driverPose.qWorldFromDriverRotation.y,
-			driverPose.qWorldFromDriverRotation.z
-		);
-		Eigen::Vector3d driverToWorldV(
-			driverPose.vecWorldFromDriverTranslation[0],
-			driverPose.vecWorldFromDriverTranslation[1],
-			driverPose.vecWorldFromDriverTranslation[2]
-		);
-
-		Eigen::Quaterniond driverRot = driverToWorldQ * Eigen::Quaterniond(
-			driverPose.qRotation.w,
-			driverPose.qRotation.x,
-			driverPose.qRotation.y,
-			driverPose.qRotation.z
-		);
-		
-		Eigen::Vector3d driverPos = driverToWorldV + driverToWorldQ * Eigen::Vector3d(
-			driverPose.vecPosition[0],
-			driverPose.vecPosition[1],
-			driverPose.vecPosition[2]
-		);
-
-		Eigen::AffineCompact3d xform = Eigen::Translation3d(driverPos) * driverRot;
-
-		return Pose(xform);
+	/*
+	 * The continuous calibration offset is added to the reference's driver-space position; the compact records are
+	 * already in world space, so it is rotated the way the reference's driver space is.
+	 */
+	Eigen::Vector3d ReferenceOffset(const CalibrationContext& ctx)
+	{
+		const vr::HmdQuaternion_t& q = ctx.devicePoses[ctx.referenceID].qWorldFromDriverRotation;
+		return Eigen::Quaterniond(q.w, q.x, q.y, q.z) * ctx.continuousCalibrationOffset;
 	}
 
 	bool CollectSample(const CalibrationContext& ctx)
@@ -185,22 +240,66 @@ namespace {
 			return false;
 		}
 
-		// Apply tracker offsets
-		if (CalCtx.state == CalibrationState::Continuous || CalCtx.state == CalibrationState::ContinuousStandby) {
-			reference.vecPosition[0] += ctx.continuousCalibrationOffset.x();
-			reference.vecPosition[1] += ctx.continuousCalibrationOffset.y();
-			reference.vecPosition[2] += ctx.continuousCalibrationOffset.z();
-		}
+		calibration.windowPolicy = ctx.coresetWindow ? CalibrationCalc::WindowPolicy::Coreset : CalibrationCalc::WindowPolicy::Fifo;
+		// A one-shot window only needs to fill with distinct poses; continuous calibration keeps taking samples
+		// while holding still, for static recalibration.
+		calibration.coresetCellLimit = ctx.state == CalibrationState::Continuous ? 0 : CalCtx.SampleCount() / CoresetMinCells;
 
-		calibration.PushSample(Sample(
-			ConvertPose(reference),
-			ConvertPose(target),
-			glfwGetTime()
-		));
+		for (const Sample& sample : ingested) {
+			calibration.AddSample(sample, CalCtx.SampleCount());
+		}
+		ingested.clear();
 
 		return true;
 	}
 
+	bool FilterActive(const CalibrationContext& ctx)
+	{
+		return ctx.state == CalibrationState::Continuous && ctx.continuousSolver == CalibrationContext::FILTER && filter.Initialized()
+			&& ctx.referenceID >= 0 && ctx.referenceID < vr::k_unMaxTrackedDeviceCount
+			&& ctx.targetID >= 0 && ctx.targetID < vr::k_unMaxTrackedDeviceCount;
+	}
+
+	/*
+	 * Runs a pose of the reference or target device through the ingestion stage. Every pair it completes goes to
+	 * the filter, if that is tracking the calibration, and the informative ones are queued for the window.
+	 */
+	void IngestPose(const CalibrationContext& ctx, const protocol::DriverPoseShmem::CompactPose& compact)
+	{
+		if (ctx.state != CalibrationState::Rotation && ctx.state != CalibrationState::Continuous) return;
+
+		TimedPose timedPose;
+		timedPose.pose.rot = Eigen::Quaterniond(compact.rotation[0], compact.rotation[1], compact.rotation[2], compact.rotation[3])
+			.normalized().toRotationMatrix();
+		timedPose.pose.trans = Eigen::Vector3f(compact.position).cast<double>();
+		timedPose.velocity = Eigen::Vector3f(compact.velocity).cast<double>();
+		timedPose.time = (double)compact.sampleTime * qpcPeriod;
+		timedPose.valid = (compact.flags & protocol::DriverPoseShmem::CompactPoseValid) != 0;
+
+		if (compact.deviceId == ctx.referenceID && ctx.state == CalibrationState::Continuous) {
+			timedPose.pose.trans += ReferenceOffset(ctx);
+		}
+
+		if (compact.deviceId == ctx.referenceID) {
+			latencyEstimator.AddReference(timedPose.time, timedPose.pose.rot, timedPose.valid);
+		} else {
+			latencyEstimator.AddTarget(timedPose.time, timedPose.pose.rot, timedPose.valid);
+		}
+
+		const bool filterActive = FilterActive(ctx);
+		ingest.Add(compact.deviceId, timedPose, [&](const Sample& sample) {
+			if (filterActive) {
+				filter.Update(sample.ref, sample.target, sample.timestamp);
+			}
+
+			if (ingest.Admit(sample)) {
+				// Only pushed into the window while the tick gets that far, so don't let a stall pile them up.
+				if (ingested.size() >= CalCtx.SampleCount()) ingested.pop_front();
+				ingested.push_back(sample);
+			}
+		});
+	}
+
 	bool AssignTargets() {
 		auto state = VRState::Load();
 		
@@ -232,6 +331,23 @@ void InitCalibrator()
 {
 	Driver.Connect();
 	shmem.Open(OPENVR_SPACECALIBRATOR_SHMEM_NAME);
+
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	qpcPeriod = 1.0 / (double)frequency.QuadPart;
+}
+
+bool StartPoseWakeup()
+{
+	if (!shmem || !shmem.HasWakeup()) return false;
+
+	poseWakeup.Start();
+	return true;
+}
+
+void StopPoseWakeup()
+{
+	poseWakeup.Stop();
 }
 
 void ResetAndDisableOffsets(uint32_t id)
@@ -355,6 +471,8 @@ void ScanAndApplyProfile(CalibrationContext &ctx)
 		};
 		req.setDeviceTransform.lerp = CalCtx.state == CalibrationState::Continuous;
 		req.setDeviceTransform.quash = CalCtx.state == CalibrationState::Continuous && id == CalCtx.targetID && CalCtx.quashTargetInContinuous;
+		// Only a lagging target can be caught up by predicting further ahead
+		req.setDeviceTransform.predictionOffset = ctx.compensateLatency ? std::max(ctx.targetLatency, 0.0) : 0.0;
 
 		Driver.SendBlocking(req);
 	}
@@ -380,6 +498,12 @@ void StartCalibration() {
 	CalCtx.wantedUpdateInterval = 0.0;
 	CalCtx.messages.clear();
 	calibration.Clear();
+	filter.Clear();
+	ingest.Clear();
+	ingested.clear();
+	nextEarlyStopSamples = MinEarlyStopSamples;
+	latencyEstimator.Clear();
+	solver.Discard();
 	Metrics::WriteLogAnnotation("StartCalibration");
 }
 
@@ -406,12 +530,116 @@ void EndContinuousCalibration() {
 	Metrics::WriteLogAnnotation("EndContinuousCalibration");
 }
 
+/*
+ * Applies a finished background solve on the main thread: takes over its estimate, replays the metrics and
+ * log lines it recorded, and saves and applies the resulting profile.
+ */
+static void PublishSolve(CalibrationCalc& solved, const SolverWorker::Job& job, double duration)
+{
+	auto &ctx = CalCtx;
+
+	// Cancelled or switched modes while solving
+	const auto solvingState = job.continuous ? CalibrationState::Continuous : CalibrationState::Rotation;
+	if (ctx.state != solvingState) return;
+
+	// Not there yet; keep collecting
+	if (job.earlyStop && !solved.Converged()) return;
+
+	if (job.continuous) {
+		CalCtx.messages.clear();
+	}
+	solved.ReplayReport();
+	calibration.AdoptEstimate(solved);
+
+	if (calibration.isValid()) {
+		ctx.calibratedRotation = calibration.EulerRotation();
+		ctx.calibratedTranslation = calibration.Transformation().translation() * 100.0; // convert to cm units for profile storage
+		ctx.refToTargetPose = calibration.RelativeTransformation();
+		ctx.relativePosCalibrated = calibration.isRelativeTransformationCalibrated();
+
+		auto vrTrans = VRTranslationVec(ctx.calibratedTranslation);
+		auto vrRot = VRRotationQuat(Eigen::Quaterniond(calibration.Transformation().rotation()));
+
+		ctx.validProfile = true;
+		SaveProfile(ctx);
+
+		ScanAndApplyProfile(ctx);
+
+		CalCtx.hasAppliedCalibrationResult = true;
+
+		if (job.continuous && ctx.continuousSolver == CalibrationContext::FILTER && ctx.relativePosCalibrated && !filter.Initialized()) {
+			filter.Reset(calibration.Transformation(), calibration.RelativeTransformation());
+			filterPublished = calibration.Transformation();
+			CalCtx.Log("Tracking calibration with the filter\n");
+		}
+
+		if (job.earlyStop) {
+			char buf[256];
+			snprintf(buf, sizeof buf, "Converged after %zu samples (+-%.2f mm, +-%.3f deg)\n",
+				solved.SampleCount(), solved.TranslationSigma() * 1000.0, (double)(solved.RotationSigma() * 180.0 / EIGEN_PI));
+			CalCtx.Log(buf);
+		}
+		CalCtx.Log("Finished calibration, profile saved\n");
+	} else {
+		CalCtx.Log("Calibration failed.\n");
+	}
+
+	Metrics::computationTime.Push(duration * 1000.0);
+
+	Metrics::WriteLogEntry();
+
+	if (!job.continuous) {
+		ctx.state = CalibrationState::None;
+		calibration.Clear();
+	}
+}
+
+/*
+ * Pushes the filter's estimate out to the profile, skipping updates too small to matter so that the profile isn't
+ * rewritten on every tick.
+ */
+static void PublishFilter()
+{
+	auto &ctx = CalCtx;
+
+	Metrics::RecordTimestamp();
+	Metrics::filterSigmaTrans.Push(filter.TranslationSigma() * 1000.0);
+	Metrics::filterSigmaRot.Push(filter.RotationSigma() * 180.0 / EIGEN_PI);
+
+	const Eigen::AffineCompact3d& estimate = filter.Transformation();
+	const double moved = (estimate.translation() - filterPublished.translation()).norm();
+	const double turned = Eigen::AngleAxisd(estimate.linear() * filterPublished.linear().transpose()).angle();
+	if (moved < 0.001 && turned < 0.001) {
+		Metrics::WriteLogEntry();
+		return;
+	}
+	filterPublished = estimate;
+
+	calibration.setRelativeTransformation(filter.RelativeTransformation(), true);
+
+	ctx.calibratedRotation = estimate.rotation().eulerAngles(2, 1, 0) * 180.0 / EIGEN_PI;
+	ctx.calibratedTranslation = estimate.translation() * 100.0; // convert to cm units for profile storage
+	ctx.refToTargetPose = filter.RelativeTransformation();
+	ctx.relativePosCalibrated = true;
+
+	ctx.validProfile = true;
+	SaveProfile(ctx);
+
+	ScanAndApplyProfile(ctx);
+
+	Metrics::WriteLogEntry();
+}
+
 void CalibrationTick(double time)
 {
 	if (!vr::VRSystem())
 		return;
 
 	auto &ctx = CalCtx;
+
+	solver.Collect(PublishSolve);
+	poseWakeup.SetInterval(std::max(ctx.wantedUpdateInterval, PoseWakeupInterval));
+
 	if ((time - ctx.timeLastTick) < 0.05)
 		return;
 
@@ -426,11 +654,36 @@ void CalibrationTick(double time)
 	}
 
 	ctx.timeLastTick = time;
-	shmem.ReadNewPoses([&](const protocol::DriverPoseShmem::AugmentedPose& augmented_pose) {
-		if (augmented_pose.deviceId >= 0 && augmented_pose.deviceId <= vr::k_unMaxTrackedDeviceCount) {
-			ctx.devicePoses[augmented_pose.deviceId] = augmented_pose.pose;
+	ingest.SetDevices(ctx.referenceID, ctx.targetID);
+	ingest.SetTargetLatency(ctx.targetLatency);
+	for (int id = 0; id < (int)vr::k_unMaxTrackedDeviceCount; id++) {
+		protocol::DriverPoseShmem::AugmentedPose latest;
+		if (shmem.GetLatestPose(id, latest)) {
+			ctx.devicePoses[id] = latest.pose;
+		}
+	}
+
+	// Only the calibrated pair needs the full pose history; everything else just wants the current pose.
+	const uint64_t lostPoses = shmem.ReadNewPoses([&](const protocol::DriverPoseShmem::CompactPose& compact) {
+		if (compact.deviceId == ctx.referenceID || compact.deviceId == ctx.targetID) {
+			IngestPose(ctx, compact);
 		}
 	});
+	if (lostPoses > 0 && (ctx.state == CalibrationState::Rotation || ctx.state == CalibrationState::Continuous)) {
+		char buf[256];
+		snprintf(buf, sizeof buf, "Fell behind the driver, dropped %llu poses\n", (unsigned long long)lostPoses);
+		CalCtx.Log(buf);
+	}
+
+	if (time - timeLastLatencyUpdate >= 1.0) {
+		timeLastLatencyUpdate = time;
+
+		if (latencyEstimator.Update()) {
+			ctx.targetLatency = latencyEstimator.Latency();
+			Metrics::RecordTimestamp();
+			Metrics::latency.Push(ctx.targetLatency * 1000.0);
+		}
+	}
 
 	// check for non-updating headset tracking space (caused by quest out of bounds or taken off head for example) and abort everything for this tick
 	auto p = ctx.devicePoses[vr::k_unTrackedDeviceIndex_Hmd].vecPosition;
@@ -508,8 +761,10 @@ void CalibrationTick(double time)
 
 		ScanAndApplyProfile(ctx);
 
-		Metrics::jitterRef.Push(calibration.ReferenceJitter());
-		Metrics::jitterRef.Push(calibration.TargetJitter());
+		const double referenceJitter = calibration.ReferenceJitter();
+		const double targetJitter = calibration.TargetJitter();
+		Metrics::jitterRef.Push(referenceJitter);
+		Metrics::jitterTarget.Push(targetJitter);
 
 		if (!CalCtx.ReferencePoseIsValidSimple())
 		{
@@ -522,10 +777,10 @@ void CalibrationTick(double time)
 		}
 		
 		// @TOOD: Determine if the tracking is jittery
-		if (calibration.ReferenceJitter() > ctx.jitterThreshold) {
+		if (referenceJitter > ctx.jitterThreshold) {
 			CalCtx.Log("Reference device is not tracking\n"); ok = false;
 		}
-		if (calibration.TargetJitter() > ctx.jitterThreshold) {
+		if (targetJitter > ctx.jitterThreshold) {
 			CalCtx.Log("Target device is not tracking\n"); ok = false;
 		}
 
@@ -549,6 +804,8 @@ void CalibrationTick(double time)
 		return;
 	}
 
+	// Nothing admitted since the last tick means nothing new to solve for, though the filter may still have moved on
+	const bool admitted = !ingested.empty();
 	if (!CollectSample(ctx))
 	{
 		return;
@@ -556,7 +813,9 @@ void CalibrationTick(double time)
 
 	CalCtx.Progress((int) calibration.SampleCount(), (int)CalCtx.SampleCount());
 
-	if (calibration.SampleCount() < CalCtx.SampleCount()) return;
+	// A one-shot window is solved every so often while it fills up, and finishes early once the solve has converged
+	const bool earlyStop = calibration.SampleCount() < CalCtx.SampleCount();
+	if (earlyStop && (ctx.state != CalibrationState::Rotation || calibration.SampleCount() < nextEarlyStopSamples)) return;
 	while (calibration.SampleCount() > CalCtx.SampleCount()) calibration.ShiftSample();
 
 	if (CalCtx.state == CalibrationState::Continuous && CalCtx.requireTriggerPressToApply && CalCtx.hasAppliedCalibrationResult) {
@@ -587,61 +846,54 @@ void CalibrationTick(double time)
 		}
 	}
 
-	LARGE_INTEGER start_time;
-	QueryPerformanceCounter(&start_time);
-		
-	bool lerp = false;
+	if (CalCtx.state == CalibrationState::Continuous && CalCtx.continuousSolver == CalibrationContext::FILTER) {
+		if (filter.Diverged()) {
+			CalCtx.Log("Filter lost track, solving from scratch...\n");
+			filter.Clear();
+		}
 
-	if (CalCtx.state == CalibrationState::Continuous) {
-		CalCtx.messages.clear();
-		calibration.enableStaticRecalibration = CalCtx.enableStaticRecalibration;
-		calibration.lockRelativePosition = CalCtx.lockRelativePosition;
-		calibration.ComputeIncremental(lerp, CalCtx.continuousCalibrationThreshold, CalCtx.maxRelativeErrorThreshold, CalCtx.ignoreOutliers);
-	}
-	else {
-		calibration.enableStaticRecalibration = false;
-		calibration.ComputeOneshot(CalCtx.ignoreOutliers);
+		// The filter is fed straight from the pose stream; the window only keeps sliding in case it has to reseed.
+		if (filter.Initialized()) {
+			PublishFilter();
+			return;
+		}
+	} else {
+		filter.Clear();
 	}
 
-	if (calibration.isValid()) {
-		ctx.calibratedRotation = calibration.EulerRotation();
-		ctx.calibratedTranslation = calibration.Transformation().translation() * 100.0; // convert to cm units for profile storage
-		ctx.refToTargetPose = calibration.RelativeTransformation();
-		ctx.relativePosCalibrated = calibration.isRelativeTransformationCalibrated();
+	// A continuous window stays full and slides as samples are admitted, so any admitted sample can start the next
+	// solve; holding still still gets one every StillAdmitInterval for static recalibration.
+	if (!admitted) return;
 
-		auto vrTrans = VRTranslationVec(ctx.calibratedTranslation);
-		auto vrRot = VRRotationQuat(Eigen::Quaterniond(calibration.Transformation().rotation()));
-
-		ctx.validProfile = true;
-		SaveProfile(ctx);
+	// Samples keep coming in while a solve is running; the window just keeps sliding until it's done.
+	if (solver.Busy()) return;
 
-		ScanAndApplyProfile(ctx);
+	SolverWorker::Job job;
+	job.continuous = CalCtx.state == CalibrationState::Continuous;
+	job.threshold = CalCtx.continuousCalibrationThreshold;
+	job.relPoseMaxError = CalCtx.maxRelativeErrorThreshold;
+	job.ignoreOutliers = CalCtx.ignoreOutliers;
+	job.earlyStop = earlyStop;
 
-		CalCtx.hasAppliedCalibrationResult = true;
+	calibration.solverMode = CalCtx.allPairsSolver ? CalibrationCalc::SolverMode::AllPairs : CalibrationCalc::SolverMode::Streaming;
+	calibration.parallelSolve = CalCtx.parallelSolver;
+	calibration.solveBudget = CalCtx.solveBudgetMs / 1000.0;
+	calibration.continuousEngine = CalCtx.continuousSolver == CalibrationContext::REFINE
+		? CalibrationCalc::ContinuousEngine::Refine : CalibrationCalc::ContinuousEngine::ClosedForm;
 
-		CalCtx.Log("Finished calibration, profile saved\n");
-	} else {
-		CalCtx.Log("Calibration failed.\n");
+	if (job.continuous) {
+		calibration.enableStaticRecalibration = CalCtx.enableStaticRecalibration;
+		calibration.lockRelativePosition = CalCtx.lockRelativePosition;
+	}
+	else {
+		calibration.enableStaticRecalibration = false;
 	}
 
-	LARGE_INTEGER end_time;
-	QueryPerformanceCounter(&end_time);
-	LARGE_INTEGER freq;
-	QueryPerformanceFrequency(&freq);
-	double duration = (end_time.QuadPart - start_time.QuadPart) / (double)freq.QuadPart;
-	Metrics::computationTime.Push(duration * 1000.0);
+	Metrics::RecordTimestamp();
+	solver.Submit(calibration, job);
 
-	Metrics::WriteLogEntry();
-		
-	if (CalCtx.state != CalibrationState::Continuous) {
-		ctx.state = CalibrationState::None;
-		calibration.Clear();
-	}
-	else {
-		size_t drop_samples = CalCtx.SampleCount() / 10;
-		for (int i = 0; i < drop_samples; i++) {
-			calibration.ShiftSample();
-		}
+	if (earlyStop) {
+		nextEarlyStopSamples = calibration.SampleCount() + EarlyStopInterval;
 	}
 }
 
@@ -47,9 +47,15 @@ struct CalibrationContext
 	bool clearOnLog = false;
 	bool quashTargetInContinuous = false;
 	double timeLastTick = 0, timeLastScan = 0, timeLastAssign = 0;
-	bool ignoreOutliers = false;
+	bool ignoreOutliers = true;
+	bool parallelSolver = true;
+	bool allPairsSolver = false; // debug: solve with the reference all-pairs path instead of the streaming one
 	double wantedUpdateInterval = 1.0;
 	float jitterThreshold = 3.0f;
+	float solveBudgetMs = 0.0f; // 0 = unbounded
+	double targetLatency = 0.0; // measured seconds by which the target system's poses lag the reference's
+	bool compensateLatency = false;
+	bool coresetWindow = true; // evict redundant samples rather than the oldest
 
 	bool requireTriggerPressToApply = false;
 	bool wasWaitingForTriggers = false;
@@ -76,6 +82,14 @@ struct CalibrationContext
 	};
 	Speed calibrationSpeed = FAST;
 
+	enum ContinuousSolver
+	{
+		CLOSED_FORM = 0,
+		REFINE = 1,
+		FILTER = 2
+	};
+	ContinuousSolver continuousSolver = CLOSED_FORM;
+
 	vr::DriverPose_t devicePoses[vr::k_unMaxTrackedDeviceCount];
 
 	CalibrationContext() {
@@ -100,6 +114,7 @@ struct CalibrationContext
 		continuousCalibrationThreshold = 1.5f;
 		maxRelativeErrorThreshold = 0.005f;
 		jitterThreshold = 3.0f;
+		solveBudgetMs = 0.0f;
 
 		continuousCalibrationOffset = Eigen::Vector3d::Zero();
 
@@ -139,6 +154,7 @@ struct CalibrationContext
 		validProfile = false;
 		refToTargetPose = Eigen::AffineCompact3d::Identity();
 		relativePosCalibrated = true;
+		targetLatency = 0.0;
 	}
 
 	size_t SampleCount()
@@ -213,6 +229,11 @@ extern CalibrationContext CalCtx;
 
 void InitCalibrator();
 void CalibrationTick(double time);
+
+// Wakes the run loop up with an empty GLFW event whenever the driver has poses for the next tick. Returns false if
+// the driver can't signal them, in which case the loop has to keep polling.
+bool StartPoseWakeup();
+void StopPoseWakeup();
 void StartCalibration();
 void StartContinuousCalibration();
 void EndContinuousCalibration();
@@ -0,0 +1,310 @@
+#include "CalibrationAccumulators.h"
+#include "CalibrationCalc.h"
+
+#include <algorithm>
+
+void TranslationAccumulator::Clear() {
+	m_count = 0;
+
+	m_refRotT.setZero();
+	m_refTrans.setZero();
+	m_refRotTRefTrans.setZero();
+
+	m_targetRot.setZero();
+	m_targetTrans.setZero();
+	m_targetRotTTargetTrans.setZero();
+
+	for (int c = 0; c < 3; c++) {
+		m_refRotTTargetTrans[c].setZero();
+		m_targetRotTRefTrans[c].setZero();
+	}
+}
+
+void TranslationAccumulator::Accumulate(const Sample& sample, double sign) {
+	const Eigen::Matrix3d refRotT = sample.ref.rot.transpose();
+	const Eigen::Matrix3d targetRotT = sample.target.rot.transpose();
+
+	m_refRotT += sign * refRotT;
+	m_refTrans += sign * sample.ref.trans;
+	m_refRotTRefTrans += sign * (refRotT * sample.ref.trans);
+
+	m_targetRot += sign * sample.target.rot;
+	m_targetTrans += sign * sample.target.trans;
+	m_targetRotTTargetTrans += sign * (targetRotT * sample.target.trans);
+
+	for (int c = 0; c < 3; c++) {
+		m_refRotTTargetTrans[c] += (sign * sample.target.trans(c)) * refRotT;
+		m_targetRotTRefTrans[c] += (sign * sample.ref.trans(c)) * targetRotT;
+	}
+}
+
+Eigen::Vector3d TranslationAccumulator::Solve(const Eigen::Matrix3d& rotation) const {
+	// With Q_k the per-sample coefficient block and v_k = tr - R * tt, every pair contributes
+	//   AtA += (Q_j - Q_i)^T (Q_j - Q_i)    Atb += (Q_j - Q_i)^T (Q_j v_j - Q_i v_i)
+	// which sums to N * sum(Q^T Q) - sum(Q)^T sum(Q) and N * sum(Q^T Q v) - sum(Q)^T sum(Q v).
+	// Both blocks use rotation matrices for Q, so Q^T Q = I.
+	const double n = (double)m_count;
+	const Eigen::Matrix3d nnI = Eigen::Matrix3d::Identity() * (n * n);
+	const Eigen::Vector3d sumV = m_refTrans - rotation * m_targetTrans;
+
+	// Reference block: Q_k = Rr^T
+	Eigen::Vector3d sumQvA = m_refRotTRefTrans;
+	for (int c = 0; c < 3; c++) {
+		sumQvA -= m_refRotTTargetTrans[c] * rotation.col(c);
+	}
+	const Eigen::Matrix3d AtA_A = nnI - m_refRotT.transpose() * m_refRotT;
+	const Eigen::Vector3d Atb_A = n * sumV - m_refRotT.transpose() * sumQvA;
+
+	// Target block: Q_k = (R * Rt)^T = Rt^T * R^T
+	Eigen::Vector3d sumQvB = -m_targetRotTTargetTrans;
+	for (int c = 0; c < 3; c++) {
+		sumQvB += m_targetRotTRefTrans[c] * rotation.row(c).transpose();
+	}
+	const Eigen::Matrix3d sumQBT = rotation * m_targetRot;
+	const Eigen::Matrix3d AtA_B = nnI - sumQBT * sumQBT.transpose();
+	const Eigen::Vector3d Atb_B = n * sumV - sumQBT * sumQvB;
+
+	const Eigen::Matrix3d AtA = AtA_A + AtA_B;
+	const Eigen::Vector3d Atb = Atb_A + Atb_B;
+
+	return Eigen::JacobiSVD<Eigen::Matrix3d>(AtA, Eigen::ComputeFullU | Eigen::ComputeFullV).solve(Atb);
+}
+
+namespace {
+	Eigen::Matrix3d Skew(const Eigen::Vector3d& v) {
+		Eigen::Matrix3d m;
+		m << 0, -v.z(), v.y(),
+			v.z(), 0, -v.x(),
+			-v.y(), v.x(), 0;
+		return m;
+	}
+}
+
+void RetargetingAccumulator::Clear() {
+	m_count = 0;
+
+	m_targetTrans.setZero();
+	m_targetOuter.setZero();
+	m_refTrans.setZero();
+	m_refSquared = 0;
+	m_targetRef.setZero();
+	m_refRot.setZero();
+	m_refRotTRefTrans.setZero();
+
+	for (int c = 0; c < 3; c++) {
+		m_targetRefRot[c].setZero();
+	}
+}
+
+void RetargetingAccumulator::Accumulate(const Sample& sample, double sign) {
+	const Eigen::Vector3d& tt = sample.target.trans;
+	const Eigen::Vector3d& tr = sample.ref.trans;
+	const Eigen::Matrix3d& refRot = sample.ref.rot;
+
+	m_targetTrans += sign * tt;
+	m_targetOuter += sign * (tt * tt.transpose());
+	m_refTrans += sign * tr;
+	m_refSquared += sign * tr.squaredNorm();
+	m_targetRef += sign * (tt * tr.transpose());
+	m_refRot += sign * refRot;
+	m_refRotTRefTrans += sign * (refRot.transpose() * tr);
+
+	for (int c = 0; c < 3; c++) {
+		m_targetRefRot[c] += (sign * tt(c)) * refRot;
+	}
+}
+
+Eigen::Vector3d RetargetingAccumulator::RefRotTRotatedTarget(const Eigen::Matrix3d& rotation) const {
+	Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+	for (int c = 0; c < 3; c++) {
+		sum += m_targetRefRot[c].transpose() * rotation.col(c);
+	}
+	return sum;
+}
+
+Eigen::Vector3d RetargetingAccumulator::BestOffset(const Eigen::AffineCompact3d& calibration) const {
+	// p = mean(Rr^T * (Rc * tt + tc - tr))
+	const Eigen::Vector3d sum = RefRotTRotatedTarget(calibration.linear())
+		+ m_refRot.transpose() * calibration.translation() - m_refRotTRefTrans;
+	return sum / (double)m_count;
+}
+
+double RetargetingAccumulator::Cost(const Eigen::AffineCompact3d& calibration, const Eigen::Vector3d& offset) const {
+	const Eigen::Matrix3d& rotation = calibration.linear();
+	const Eigen::Vector3d& tc = calibration.translation();
+	const double n = (double)m_count;
+
+	// Expand |a + tc - tr - Rr * p|^2 with a = Rc * tt; |a|^2 = |tt|^2 and |Rr * p|^2 = |p|^2.
+	double aDotRef = 0, aDotRotatedOffset = 0;
+	for (int c = 0; c < 3; c++) {
+		aDotRef += rotation.col(c).dot(m_targetRef.row(c));
+		aDotRotatedOffset += rotation.col(c).dot(m_targetRefRot[c] * offset);
+	}
+
+	const double sum = m_targetOuter.trace() + n * tc.squaredNorm() + m_refSquared + n * offset.squaredNorm()
+		+ 2.0 * (rotation * m_targetTrans).dot(tc)
+		- 2.0 * aDotRef
+		- 2.0 * aDotRotatedOffset
+		- 2.0 * tc.dot(m_refTrans)
+		- 2.0 * tc.dot(m_refRot * offset)
+		+ 2.0 * m_refRotTRefTrans.dot(offset);
+
+	return 0.5 * sum;
+}
+
+void RetargetingAccumulator::Linearize(
+	const Eigen::AffineCompact3d& calibration,
+	const Eigen::Vector3d& offset,
+	Matrix6d& Hxx,
+	Matrix63d& Hxp,
+	Vector6d& gx,
+	Eigen::Vector3d& gp
+) const {
+	const Eigen::Matrix3d& rotation = calibration.linear();
+	const Eigen::Vector3d& tc = calibration.translation();
+	const double n = (double)m_count;
+	const Eigen::Matrix3d I = Eigen::Matrix3d::Identity();
+
+	// Per sample, J_x = [-[a]x, I] and J_p = -Rr. Sums over [a]x * M, with a = Rc * tt, split over the components
+	// of tt as sum_c [Rc.col(c)]x * sum(tt(c) * M).
+	const Eigen::Vector3d sumA = rotation * m_targetTrans;
+	const Eigen::Matrix3d sumAOuter = rotation * m_targetOuter * rotation.transpose();
+
+	Eigen::Matrix3d skewARefRot = Eigen::Matrix3d::Zero();   // sum([a]x * Rr)
+	Eigen::Vector3d aCrossRef = Eigen::Vector3d::Zero();      // sum(a x tr)
+	for (int c = 0; c < 3; c++) {
+		const Eigen::Matrix3d skew = Skew(rotation.col(c));
+		skewARefRot += skew * m_targetRefRot[c];
+		aCrossRef += skew * m_targetRef.row(c).transpose();
+	}
+
+	// J_x^T J_x = [[|a|^2 I - a a^T, [a]x], [-[a]x, I]]
+	Hxx.topLeftCorner<3, 3>() = sumAOuter.trace() * I - sumAOuter;
+	Hxx.topRightCorner<3, 3>() = Skew(sumA);
+	Hxx.bottomLeftCorner<3, 3>() = -Skew(sumA);
+	Hxx.bottomRightCorner<3, 3>() = n * I;
+
+	// J_x^T J_p = -[[a]x * Rr, Rr]
+	Hxp.topRows<3>() = -skewARefRot;
+	Hxp.bottomRows<3>() = -m_refRot;
+
+	// J_x^T e = [a x e, e], where a x e = a x tc - a x tr - a x (Rr * p)
+	const Eigen::Vector3d sumE = sumA + n * tc - m_refTrans - m_refRot * offset;
+	gx.head<3>() = sumA.cross(tc) - aCrossRef - skewARefRot * offset;
+	gx.tail<3>() = sumE;
+
+	// J_p^T e = -Rr^T e
+	gp = -(RefRotTRotatedTarget(rotation) + m_refRot.transpose() * tc - m_refRotTRefTrans - n * offset);
+}
+
+void DeltaRotationAccumulator::Clear() {
+	m_count = 0;
+	m_ref.setZero();
+	m_target.setZero();
+	m_refTarget.setZero();
+}
+
+void DeltaRotationAccumulator::Accumulate(const Eigen::Vector3d& ref, const Eigen::Vector3d& target, double sign) {
+	m_ref += sign * ref;
+	m_target += sign * target;
+	m_refTarget += sign * (ref * target.transpose());
+}
+
+DeltaRotationAccumulator& DeltaRotationAccumulator::operator+=(const DeltaRotationAccumulator& other) {
+	m_count += other.m_count;
+	m_ref += other.m_ref;
+	m_target += other.m_target;
+	m_refTarget += other.m_refTarget;
+	return *this;
+}
+
+DeltaRotationAccumulator& DeltaRotationAccumulator::operator-=(const DeltaRotationAccumulator& other) {
+	assert(m_count >= other.m_count);
+	m_count -= other.m_count;
+	m_ref -= other.m_ref;
+	m_target -= other.m_target;
+	m_refTarget -= other.m_refTarget;
+	return *this;
+}
+
+Eigen::Matrix3d DeltaRotationAccumulator::CrossCovariance() const {
+	if (m_count == 0) return Eigen::Matrix3d::Zero();
+
+	return m_refTarget - m_ref * m_target.transpose() / (double)m_count;
+}
+
+void QuaternionMoments::Clear() {
+	m_count = 0;
+	m_sum.setZero();
+	m_outer.setZero();
+}
+
+void QuaternionMoments::Accumulate(const Eigen::Quaterniond& q, double sign) {
+	const Eigen::Vector4d v(q.w(), q.x(), q.y(), q.z());
+	m_sum += sign * v;
+	m_outer += sign * (v * v.transpose());
+}
+
+Eigen::Quaterniond QuaternionMoments::Mean() const {
+	Eigen::SelfAdjointEigenSolver<Eigen::Matrix4d> solver;
+	solver.compute(m_outer);
+
+	// Eigenvalues are sorted in increasing order
+	const Eigen::Vector4d v = solver.eigenvectors().col(3).normalized();
+	return Eigen::Quaterniond(v(0), v(1), v(2), v(3));
+}
+
+Eigen::Matrix4d QuaternionMoments::Covariance() const {
+	if (m_count == 0) return Eigen::Matrix4d::Zero();
+
+	const Eigen::Vector4d mean = m_sum / (double)m_count;
+	return m_outer / (double)m_count - mean * mean.transpose();
+}
+
+double QuaternionMoments::Spread() const {
+	if (m_count == 0) return 0.0;
+
+	// For the mean m, the largest eigenvalue is sum((q . m)^2) = sum(cos^2(angle / 2)).
+	Eigen::SelfAdjointEigenSolver<Eigen::Matrix4d> solver;
+	solver.compute(m_outer, Eigen::EigenvaluesOnly);
+
+	const double meanSinSq = std::min(std::max(1.0 - solver.eigenvalues()(3) / m_count, 0.0), 1.0);
+	return 2.0 * asin(sqrt(meanSinSq));
+}
+
+void JitterAccumulator::Clear() {
+	m_count = 0;
+	m_mean.setZero();
+	m_squaredDeviations.setZero();
+	m_rotations.Clear();
+}
+
+void JitterAccumulator::Add(const Eigen::Vector3d& trans, const Eigen::Quaterniond& rot) {
+	m_count++;
+	const Eigen::Vector3d delta = trans - m_mean;
+	m_mean += delta / (double)m_count;
+	m_squaredDeviations += delta.cwiseProduct(trans - m_mean);
+
+	m_rotations.Add(rot);
+}
+
+void JitterAccumulator::Remove(const Eigen::Vector3d& trans, const Eigen::Quaterniond& rot) {
+	if (m_count <= 1) {
+		Clear();
+		return;
+	}
+
+	// Welford's update run backwards
+	m_count--;
+	const Eigen::Vector3d delta = trans - m_mean;
+	m_mean -= delta / (double)m_count;
+	m_squaredDeviations -= delta.cwiseProduct(trans - m_mean);
+	m_squaredDeviations = m_squaredDeviations.cwiseMax(0.0);
+
+	m_rotations.Remove(rot);
+}
+
+Eigen::Vector3d JitterAccumulator::PositionVariance() const {
+	if (m_count < 2) return Eigen::Vector3d::Zero();
+	return m_squaredDeviations / (double)(m_count - 1);
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <cassert>
+
+struct Sample;
+
+/*
+ * Running sufficient statistics for the translation least-squares problem solved by CalibrationCalc.
+ *
+ * The all-pairs formulation stacks two 3x3 constraint blocks dQ * t = C for every sample pair (i, j), where both
+ * dQ and C are differences of per-sample terms (Q_j - Q_i and Q_j v_j - Q_i v_i). Since summing
+ * (x_j - x_i)^T (y_j - y_i) over all pairs is N * sum(x^T y) - sum(x)^T sum(y), the normal equations AtA and Atb
+ * can be formed from per-sample sums alone, which we can add and remove as samples enter and leave the window.
+ *
+ * The calibration rotation only enters linearly, so the sums are kept rotation-free (including a pair of
+ * 3x3x3 tensors) and the rotation is applied when solving.
+ */
+class TranslationAccumulator {
+public:
+	TranslationAccumulator() { Clear(); }
+
+	void Add(const Sample& sample) { Accumulate(sample, 1.0); m_count++; }
+	void Remove(const Sample& sample) { Accumulate(sample, -1.0); m_count--; }
+	void Clear();
+
+	size_t Count() const { return m_count; }
+
+	Eigen::Vector3d Solve(const Eigen::Matrix3d& rotation) const;
+
+private:
+	void Accumulate(const Sample& sample, double sign);
+
+	size_t m_count;
+
+	// Reference device terms
+	Eigen::Matrix3d m_refRotT;            // sum(Rr^T)
+	Eigen::Vector3d m_refTrans;           // sum(tr)
+	Eigen::Vector3d m_refRotTRefTrans;    // sum(Rr^T * tr)
+	Eigen::Matrix3d m_refRotTTargetTrans[3]; // [c] = sum(Rr^T * tt(c))
+
+	// Target device terms
+	Eigen::Matrix3d m_targetRot;          // sum(Rt)
+	Eigen::Vector3d m_targetTrans;        // sum(tt)
+	Eigen::Vector3d m_targetRotTTargetTrans; // sum(Rt^T * tt)
+	Eigen::Matrix3d m_targetRotTRefTrans[3]; // [c] = sum(Rt^T * tr(c))
+};
+
+/*
+ * Running sums for the retargeting residual e = Rc * tt + tc - tr - Rr * p of every sample, where (Rc, tc) is the
+ * calibration and p the offset of the target in the reference device's local space.
+ *
+ * The residual is linear in the calibration and offset, so its cost and its Gauss-Newton system for any of them
+ * are polynomials in a fixed set of per-sample sums. That lets CalibrationCalc refine a calibration in O(1) per
+ * iteration, however many samples the window holds.
+ */
+class RetargetingAccumulator {
+public:
+	typedef Eigen::Matrix<double, 6, 6> Matrix6d;
+	typedef Eigen::Matrix<double, 6, 3> Matrix63d;
+	typedef Eigen::Matrix<double, 6, 1> Vector6d;
+
+	RetargetingAccumulator() { Clear(); }
+
+	void Add(const Sample& sample) { Accumulate(sample, 1.0); m_count++; }
+	void Remove(const Sample& sample) { Accumulate(sample, -1.0); m_count--; }
+	void Clear();
+
+	size_t Count() const { return m_count; }
+
+	// The offset minimizing the residual for the given calibration.
+	Eigen::Vector3d BestOffset(const Eigen::AffineCompact3d& calibration) const;
+
+	// Half the sum of squared residuals.
+	double Cost(const Eigen::AffineCompact3d& calibration, const Eigen::Vector3d& offset) const;
+
+	/*
+	 * Normal equations of the residual over the perturbation x = (rotation, translation) of the calibration, with
+	 * the rotation perturbed on the left (Rc <- exp(dtheta) * Rc), and the offset p. The p-p block is Count()
+	 * times the identity, since every Rr is orthonormal.
+	 */
+	void Linearize(const Eigen::AffineCompact3d& calibration, const Eigen::Vector3d& offset,
+		Matrix6d& Hxx, Matrix63d& Hxp, Vector6d& gx, Eigen::Vector3d& gp) const;
+
+private:
+	void Accumulate(const Sample& sample, double sign);
+
+	// sum(Rr^T * Rc * tt)
+	Eigen::Vector3d RefRotTRotatedTarget(const Eigen::Matrix3d& rotation) const;
+
+	size_t m_count;
+
+	Eigen::Vector3d m_targetTrans;        // sum(tt)
+	Eigen::Matrix3d m_targetOuter;        // sum(tt * tt^T)
+	Eigen::Vector3d m_refTrans;           // sum(tr)
+	double m_refSquared;                  // sum(|tr|^2)
+	Eigen::Matrix3d m_targetRef;          // sum(tt * tr^T)
+	Eigen::Matrix3d m_refRot;             // sum(Rr)
+	Eigen::Vector3d m_refRotTRefTrans;    // sum(Rr^T * tr)
+	Eigen::Matrix3d m_targetRefRot[3];    // [c] = sum(tt(c) * Rr)
+};
+
+/*
+ * Running sums over the rotation axis pairs produced by DeltaRotationSamples. The centered cross-covariance
+ * used by the Kabsch step only depends on the pair count, the axis sums and the sum of their outer products,
+ * so pairs can be added and removed as samples enter and leave the window.
+ */
+class DeltaRotationAccumulator {
+public:
+	DeltaRotationAccumulator() { Clear(); }
+
+	void Add(const Eigen::Vector3d& ref, const Eigen::Vector3d& target) { Accumulate(ref, target, 1.0); m_count++; }
+	void Remove(const Eigen::Vector3d& ref, const Eigen::Vector3d& target) {
+		// Only pairs that were added may be removed; the rotation delta kernel gives a pair the same result both ways
+		assert(m_count > 0);
+		Accumulate(ref, target, -1.0);
+		m_count--;
+	}
+	void Clear();
+
+	DeltaRotationAccumulator& operator+=(const DeltaRotationAccumulator& other);
+	DeltaRotationAccumulator& operator-=(const DeltaRotationAccumulator& other);
+
+	size_t Count() const { return m_count; }
+
+	// sum((ref - refCentroid) * (target - targetCentroid)^T)
+	Eigen::Matrix3d CrossCovariance() const;
+
+private:
+	void Accumulate(const Eigen::Vector3d& ref, const Eigen::Vector3d& target, double sign);
+
+	size_t m_count;
+	Eigen::Vector3d m_ref, m_target;
+	Eigen::Matrix3d m_refTarget;
+};
+
+/*
+ * Running moments of a set of unit quaternions, taken as (w, x, y, z) 4-vectors.
+ *
+ * The average rotation is the principal eigenvector of the sum of outer products
+ * (https://stackoverflow.com/a/27410865/36723). Unlike averaging the components, this doesn't depend on which of
+ * q and -q each rotation happens to be stored as, and only needs a fixed-size 4x4 eigen solve.
+ */
+class QuaternionMoments {
+public:
+	QuaternionMoments() { Clear(); }
+
+	void Add(const Eigen::Quaterniond& q) { Accumulate(q, 1.0); m_count++; }
+	void Remove(const Eigen::Quaterniond& q) { Accumulate(q, -1.0); m_count--; }
+	void Clear();
+
+	size_t Count() const { return m_count; }
+
+	Eigen::Quaterniond Mean() const;
+
+	// Covariance of the components, as stored rather than sign-aligned.
+	Eigen::Matrix4d Covariance() const;
+
+	// RMS angle of the rotations from their mean, in radians.
+	double Spread() const;
+
+private:
+	void Accumulate(const Eigen::Quaterniond& q, double sign);
+
+	size_t m_count;
+	Eigen::Vector4d m_sum;
+	Eigen::Matrix4d m_outer;
+};
+
+/*
+ * Sliding-window spread of a device's poses, for judging how jittery its tracking is.
+ *
+ * Positions use Welford's running mean and sum of squared deviations, which can be updated in either direction,
+ * so a sample can be taken back out when it leaves the window. Rotations keep the quaternion moments above. Both
+ * are O(1) to update and to query.
+ */
+class JitterAccumulator {
+public:
+	JitterAccumulator() { Clear(); }
+
+	void Add(const Eigen::Vector3d& trans, const Eigen::Quaterniond& rot);
+	void Remove(const Eigen::Vector3d& trans, const Eigen::Quaterniond& rot);
+	void Clear();
+
+	size_t Count() const { return m_count; }
+
+	// Per-axis sample variance of the positions.
+	Eigen::Vector3d PositionVariance() const;
+
+	// Magnitude of the per-axis standard deviation vector of the positions.
+	double PositionJitter() const { return sqrt(PositionVariance().sum()); }
+
+	// RMS angle of the rotations from their mean, in radians.
+	double RotationJitter() const { return m_count > 1 ? m_rotations.Spread() : 0.0; }
+
+	const QuaternionMoments& Rotations() const { return m_rotations; }
+
+private:
+	size_t m_count;
+	Eigen::Vector3d m_mean;
+	Eigen::Vector3d m_squaredDeviations;
+	QuaternionMoments m_rotations;
+};
@@ -2,6 +2,10 @@
 #include "Calibration.h"
 #include "CalibrationMetrics.h"
 #include "Protocol.h"
+#include "SolverThreadPool.h"
+#include "RotationDeltaKernel.h"
+
+#include <algorithm>
 
 inline vr::HmdQuaternion_t operator*(const vr::HmdQuaternion_t& lhs, const vr::HmdQuaternion_t& rhs) {
 	return {
@@ -47,16 +51,6 @@ namespace {
 		return str.compare(str.length() - suffix.length(), suffix.length(), suffix) == 0;
 	}
 
-	Eigen::Vector3d AxisFromRotationMatrix3(Eigen::Matrix3d rot)
-	{
-		return Eigen::Vector3d(rot(2, 1) - rot(1, 2), rot(0, 2) - rot(2, 0), rot(1, 0) - rot(0, 1));
-	}
-
-	double AngleFromRotationMatrix3(Eigen::Matrix3d rot)
-	{
-		return acos((rot(0, 0) + rot(1, 1) + rot(2, 2) - 1.0) / 2.0);
-	}
-
 	vr::HmdQuaternion_t VRRotationQuat(Eigen::Vector3d eulerdeg)
 	{
 		auto euler = eulerdeg * EIGEN_PI / 180.0;
@@ -84,80 +78,334 @@ namespace {
 		return vrTrans;
 	}
 
-	DSample DeltaRotationSamples(Sample s1, Sample s2)
+	/*
+	 * Calls fn(j, delta) for every usable rotation delta between sample i and the samples j in [begin, end), other
+	 * than i itself. Deltas are always taken from the newer to the older sample of the pair.
+	 *
+	 * When stuck together, the two tracked objects rotate as a pair, therefore their axes of rotation must be
+	 * equal between any given pair of samples. Pairs that were too close to each other are rejected by the kernel.
+	 */
+	template<typename F>
+	void ForEachRotationDelta(const SampleBuffer& samples, size_t i, size_t begin, size_t end, const F& fn)
 	{
-		// Difference in rotation between samples.
-		auto dref = s1.ref.rot * s2.ref.rot.transpose();
-		auto dtarget = s1.target.rot * s2.target.rot.transpose();
+		const Eigen::Quaterniond refQuat = samples.RefQuat(i), targetQuat = samples.TargetQuat(i);
+		const double pivotRef[4] = { refQuat.w(), refQuat.x(), refQuat.y(), refQuat.z() };
+		const double pivotTarget[4] = { targetQuat.w(), targetQuat.x(), targetQuat.y(), targetQuat.z() };
+
+		RotationDeltaBatch batch;
+		const auto visit = [&](size_t from, size_t to, double axisSign) {
+			samples.ForEachRun(from, to, [&](size_t index, size_t count, const QuaternionLanes& ref, const QuaternionLanes& target) {
+				for (size_t offset = 0; offset < count; offset += RotationDeltaBatch::Capacity) {
+					const size_t n = std::min(RotationDeltaBatch::Capacity, count - offset);
+					ComputeRotationDeltas(pivotRef, pivotTarget, ref.Offset(offset), target.Offset(offset), n, axisSign, batch);
+
+					for (size_t k = 0; k < n; k++) {
+						if (!batch.valid[k]) continue;
+
+						DSample ds;
+						ds.valid = true;
+						ds.ref = Eigen::Vector3d(batch.refX[k], batch.refY[k], batch.refZ[k]);
+						ds.target = Eigen::Vector3d(batch.targetX[k], batch.targetY[k], batch.targetZ[k]);
+						fn(index + offset + k, ds);
+					}
+				}
+			});
+		};
 
-		// When stuck together, the two tracked objects rotate as a pair,
-		// therefore their axes of rotation must be equal between any given pair of samples.
-		DSample ds;
-		ds.ref = AxisFromRotationMatrix3(dref);
-		ds.target = AxisFromRotationMatrix3(dtarget);
+		// The kernel computes i * conj(j), which is newer to older for the samples before i.
+		visit(begin, std::min(end, i), 1.0);
+		visit(std::max(begin, i + 1), end, -1.0);
+	}
 
-		// Reject samples that were too close to each other.
-		auto refA = AngleFromRotationMatrix3(dref);
-		auto targetA = AngleFromRotationMatrix3(dtarget);
-		ds.valid = refA > 0.4 && targetA > 0.4 && ds.ref.norm() > 0.01 && ds.target.norm() > 0.01;
+	struct RotationPairSets {
+		DeltaRotationAccumulator all, outlierSubset;
 
-		ds.ref.normalize();
-		ds.target.normalize();
-		return ds;
-	}
+		RotationPairSets& operator+=(const RotationPairSets& other) {
+			all += other.all;
+			outlierSubset += other.outlierSubset;
+			return *this;
+		}
+	};
+
+	/*
+	 * Per-sample terms of the pairwise translation constraints for a given calibration rotation R. With
+	 * v = tr - R * tt, the pair (i, j) contributes (Q_j - Q_i) * t = Q_j * v_j - Q_i * v_i once with Q = Rr^T
+	 * and once with Q = (R * Rt)^T, so everything that depends on a single sample is computed up front.
+	 */
+	struct TranslationTerms {
+		Eigen::Matrix3d QA, QB;
+		Eigen::Vector3d QAv, QBv;
+	};
+
+	struct NormalEquations3 {
+		Eigen::Matrix3d AtA = Eigen::Matrix3d::Zero();
+		Eigen::Vector3d Atb = Eigen::Vector3d::Zero();
+
+		void Add(const Eigen::Matrix3d& A, const Eigen::Vector3d& b) {
+			AtA += A.transpose() * A;
+			Atb += A.transpose() * b;
+		}
+
+		NormalEquations3& operator+=(const NormalEquations3& other) {
+			AtA += other.AtA;
+			Atb += other.Atb;
+			return *this;
+		}
+	};
 }
 
 const double CalibrationCalc::AxisVarianceThreshold = 0.001;
+
+// Running sums are refreshed from the window after this many evictions, so that rounding error from repeatedly
+// adding and subtracting samples can't build up over a long continuous calibration session.
+static const size_t AccumulatorRebuildInterval = 4096;
+
+// Outlier detection only looks at pairs between every Nth sample to get a rough rotation.
+static const uint64_t OutlierPairStep = 5;
+
+// Cell size of the coreset window: quaternion vector part (0.13 is about 15 degrees) and meters.
+static const double CoresetRotationCell = 0.13;
+static const double CoresetPositionCell = 0.1;
+
+// Refinement steps taken per continuous update, at most.
+static const int MaxRefineIterations = 10;
+
+// Rows of the retargeting system for the yaw (rotation about y) and the translation, the only parameters any of
+// the solves changes; the calibration never tilts the playspace.
+static const int YawTranslationRows[] = { 1, 3, 4, 5 };
+
+// If the current calibration fits the window this much worse than it did after the last solve, something
+// changed faster than refinement should chase, so re-solve in closed form instead.
+static const double RefineJumpRatio = 2.0;
+
+// A budgeted solve that covered less than this fraction of its pair work is too rough to be applied.
+static const double MinSolveCoverage = 0.25;
+
+// Largest standard deviations, in meters and radians, at which a one-shot solve counts as converged.
+static const double MaxConvergedTranslationSigma = 0.0005;
+static const double MaxConvergedRotationSigma = 0.1 * EIGEN_PI / 180.0;
+
+void CalibrationCalc::Log(const std::string& msg) {
+	m_report.Defer([msg]() { CalCtx.Log(msg); });
+}
+
 void CalibrationCalc::PushSample(const Sample& sample) {
-	m_samples.push_back(sample);
+	m_samples.Push(sample);
+	m_translationAccum.Add(sample);
+	m_retargetAccum.Add(sample);
+	AccumulateJitter(m_samples.Size() - 1, true);
+	AccumulateRotationPairs(m_samples.Size() - 1, true);
+}
+
+void CalibrationCalc::AddSample(const Sample& sample, size_t capacity) {
+	// The new sample is pushed before one is evicted, so that the coreset policy can weigh it against the rest;
+	// the one slot of headroom keeps a full window from growing the buffer.
+	m_samples.Reserve(capacity + 1);
+	PushSample(sample);
+
+	if (windowPolicy == WindowPolicy::Fifo) {
+		while (m_samples.Size() > capacity) ShiftSample();
+		return;
+	}
+
+	if (coresetCellLimit > 0) {
+		const uint64_t cell = CellOf(m_samples.Size() - 1);
+		size_t oldest = 0, count = 0;
+		for (size_t i = m_samples.Size(); i-- > 0;) {
+			if (CellOf(i) == cell) {
+				oldest = i;
+				count++;
+			}
+		}
+		if (count > coresetCellLimit) RemoveSample(oldest);
+	}
+
+	while (m_samples.Size() > capacity) {
+		RemoveSample(LeastInformativeSample());
+	}
+}
+
+void CalibrationCalc::ShiftSample() {
+	RemoveSample(0);
+}
+
+void CalibrationCalc::RemoveSample(size_t index) {
+	if (index >= m_samples.Size()) return;
+
+	const Sample removed = m_samples.At(index);
+	m_translationAccum.Remove(removed);
+	m_retargetAccum.Remove(removed);
+	AccumulateJitter(index, false);
+	AccumulateRotationPairs(index, false);
+	m_samples.Erase(index);
+
+	if (++m_shiftsSinceRebuild >= AccumulatorRebuildInterval) {
+		RebuildAccumulators();
+	}
+}
+
+// Packs the reference pose of a sample into its coreset cell, 10 bits per coordinate.
+uint64_t CalibrationCalc::CellOf(size_t index) const {
+	Eigen::Quaterniond rot = m_samples.RefQuat(index);
+	if (rot.w() < 0) rot.coeffs() = -rot.coeffs();
+
+	Eigen::Matrix<double, 6, 1> coords;
+	coords << rot.vec() / CoresetRotationCell, m_samples.RefTrans(index) / CoresetPositionCell;
+
+	uint64_t cell = 0;
+	for (int i = 0; i < 6; i++) {
+		const double bin = std::min(std::max(floor(coords(i)), -512.0), 511.0);
+		cell = (cell << 10) | (uint64_t)(int64_t)(bin + 512);
+	}
+	return cell;
+}
+
+// Index of the oldest sample in the most crowded cell, or of the oldest sample overall if no two share a cell.
+size_t CalibrationCalc::LeastInformativeSample() {
+	m_cells.resize(m_samples.Size());
+	for (size_t i = 0; i < m_samples.Size(); i++) {
+		m_cells[i] = { CellOf(i), i };
+	}
+	std::sort(m_cells.begin(), m_cells.end());
+
+	size_t best = 0, bestCount = 1;
+	for (size_t begin = 0, end; begin < m_cells.size(); begin = end) {
+		for (end = begin + 1; end < m_cells.size() && m_cells[end].first == m_cells[begin].first; end++) {}
+
+		// Each run is sorted by index, so it starts with its oldest sample
+		const size_t count = end - begin;
+		if (count > bestCount || (count == bestCount && count > 1 && m_cells[begin].second < best)) {
+			best = m_cells[begin].second;
+			bestCount = count;
+		}
+	}
+	return best;
+}
+
+void CalibrationCalc::AccumulateJitter(size_t index, bool add) {
+	if (!m_samples.Valid(index)) return;
+
+	if (add) {
+		m_refJitter.Add(m_samples.RefTrans(index), m_samples.RefQuat(index));
+		m_targetJitter.Add(m_samples.TargetTrans(index), m_samples.TargetQuat(index));
+	} else {
+		m_refJitter.Remove(m_samples.RefTrans(index), m_samples.RefQuat(index));
+		m_targetJitter.Remove(m_samples.TargetTrans(index), m_samples.TargetQuat(index));
+	}
+}
+
+bool CalibrationCalc::InOutlierSubset(size_t index) const {
+	return m_samples.Sequence(index) % OutlierPairStep == 0;
+}
+
+/*
+ * Adds or removes the rotation deltas between the sample at index and every other sample in the window.
+ * Deltas are always taken from the newer to the older sample, as BuildRotationPairs does.
+ */
+void CalibrationCalc::AccumulateRotationPairs(size_t index, bool add) {
+	const bool indexInSubset = InOutlierSubset(index);
+
+	ForEachRotationDelta(m_samples, index, 0, m_samples.Size(), [&](size_t j, const DSample& delta) {
+		const bool inSubset = indexInSubset && InOutlierSubset(j);
+		if (add) {
+			m_rotationPairs.Add(delta.ref, delta.target);
+			if (inSubset) m_outlierPairs.Add(delta.ref, delta.target);
+		} else {
+			m_rotationPairs.Remove(delta.ref, delta.target);
+			if (inSubset) m_outlierPairs.Remove(delta.ref, delta.target);
+		}
+	});
+}
+
+// Enumerates the rotation deltas of every sample pair in the window from scratch.
+void CalibrationCalc::BuildRotationPairs(DeltaRotationAccumulator* all, DeltaRotationAccumulator* outlierSubset, bool parallel, SolveBudget* budget) const {
+	auto pairs = ReduceTriangle<RotationPairSets>(m_samples.Size(), parallel, [&](RotationPairSets& acc, size_t i) {
+		const bool iInSubset = outlierSubset && InOutlierSubset(i);
+
+		if (all) {
+			ForEachRotationDelta(m_samples, i, 0, i, [&](size_t j, const DSample& delta) {
+				acc.all.Add(delta.ref, delta.target);
+				if (iInSubset && InOutlierSubset(j)) acc.outlierSubset.Add(delta.ref, delta.target);
+			});
+		} else if (iInSubset) {
+			for (size_t j = 0; j < i; j++) {
+				if (!InOutlierSubset(j)) continue;
+				ForEachRotationDelta(m_samples, i, j, j + 1, [&](size_t, const DSample& delta) {
+					acc.outlierSubset.Add(delta.ref, delta.target);
+				});
+			}
+		}
+	}, budget);
+
+	if (all) *all += pairs.all;
+	if (outlierSubset) *outlierSubset += pairs.outlierSubset;
+}
+
+void CalibrationCalc::RebuildAccumulators() {
+	m_shiftsSinceRebuild = 0;
+
+	m_translationAccum.Clear();
+	m_retargetAccum.Clear();
+	m_refJitter.Clear();
+	m_targetJitter.Clear();
+	for (size_t i = 0; i < m_samples.Size(); i++) {
+		const Sample sample = m_samples.At(i);
+		m_translationAccum.Add(sample);
+		m_retargetAccum.Add(sample);
+		AccumulateJitter(i, true);
+	}
+
+	// This runs wherever samples are evicted, usually the main thread, which mustn't queue up behind a background
+	// solve holding the thread pool; a serial pass over the window only takes a few milliseconds.
+	m_rotationPairs.Clear();
+	m_outlierPairs.Clear();
+	BuildRotationPairs(&m_rotationPairs, &m_outlierPairs, false);
 }
 
 void CalibrationCalc::Clear() {
 	m_estimatedTransformation.setIdentity();
 	m_isValid = false;
-	m_samples.clear();
+	m_samples.Clear();
+	m_translationAccum.Clear();
+	m_retargetAccum.Clear();
+	m_refJitter.Clear();
+	m_targetJitter.Clear();
+	m_rotationPairs.Clear();
+	m_outlierPairs.Clear();
+	m_shiftsSinceRebuild = 0;
 	m_axisVariance = 0.0;
+	m_lastSolveError = INFINITY;
+	m_translationSigma = INFINITY;
+	m_rotationSigma = INFINITY;
 	m_refToTargetPose = Eigen::AffineCompact3d::Identity();
 	m_relativePosCalibrated = false;
 }
 
+void CalibrationCalc::AdoptEstimate(const CalibrationCalc& solved) {
+	m_isValid = solved.m_isValid;
+	m_estimatedTransformation = solved.m_estimatedTransformation;
+	m_relativePosCalibrated = solved.m_relativePosCalibrated;
+	m_refToTargetPose = solved.m_refToTargetPose;
+	m_axisVariance = solved.m_axisVariance;
+	m_lastSolveError = solved.m_lastSolveError;
+	m_translationSigma = solved.m_translationSigma;
+	m_rotationSigma = solved.m_rotationSigma;
+	m_posOffset = solved.m_posOffset;
+}
+
 std::vector<bool> CalibrationCalc::DetectOutliers() const {
-	// Use bigger step to get a rough rotation.
-	std::vector<DSample> deltas;
-	const size_t step = 5;
-	for (size_t i = 0; i < m_samples.size(); i += step) {
-		for (size_t j = 0; j < i; j += step)
-		{
-			auto delta = DeltaRotationSamples(m_samples[i], m_samples[j]);
-			if (delta.valid) {
-				deltas.push_back(delta);
-			}
-		}
+	// Use a subset of the pairs to get a rough rotation.
+	DeltaRotationAccumulator pairs;
+	if (solverMode == SolverMode::AllPairs) {
+		BuildRotationPairs(nullptr, &pairs, parallelSolve, &m_budget);
+	} else {
+		pairs = m_outlierPairs;
 	}
 
 	// Kabsch algorithm
-	Eigen::MatrixXd refPoints(deltas.size(), 3), targetPoints(deltas.size(), 3);
-	Eigen::Vector3d refCentroid(0, 0, 0), targetCentroid(0, 0, 0);
+	const Eigen::Matrix3d crossCV = pairs.CrossCovariance();
 
-	for (size_t i = 0; i < deltas.size(); i++) {
-		refPoints.row(i) = deltas[i].ref;
-		refCentroid += deltas[i].ref;
-		targetPoints.row(i) = deltas[i].target;
-		targetCentroid += deltas[i].target;
-	}
-
-	refCentroid /= (double)deltas.size();
-	targetCentroid /= (double)deltas.size();
-
-	for (size_t i = 0; i < deltas.size(); i++) {
-		refPoints.row(i) -= refCentroid;
-		targetPoints.row(i) -= targetCentroid;
-	}
-
-	auto crossCV = refPoints.transpose() * targetPoints;
-
-	Eigen::BDCSVD<Eigen::MatrixXd> bdcsvd;
-	auto svd = bdcsvd.compute(crossCV, Eigen::ComputeThinU | Eigen::ComputeThinV);
+	Eigen::JacobiSVD<Eigen::Matrix3d> svd(crossCV, Eigen::ComputeFullU | Eigen::ComputeFullV);
 
 	Eigen::Matrix3d i = Eigen::Matrix3d::Identity();
 	if ((svd.matrixU() * svd.matrixV().transpose()).determinant() < 0) {
@@ -167,86 +415,79 @@ std::vector<bool> CalibrationCalc::DetectOutliers() const {
 	Eigen::Matrix3d rot = svd.matrixV() * i * svd.matrixU().transpose();
 	rot.transposeInPlace();
 
-	// Optimize an extrinsic from reference to target.
-	// Detect the outliers by comparing the extrinc computed from each pair of rotation to the optimized extrinsic. 
-	Eigen::MatrixXd coefficients(m_samples.size() * 4, 4);
-	Eigen::VectorXd constraints(m_samples.size() * 4);
-	std::vector<bool> valids(m_samples.size());
-	Eigen::Matrix4d I4 = Eigen::Matrix4d::Identity();
-	for (size_t i = 0; i < m_samples.size(); i++) {
-		Eigen::Matrix3d rotExtTmp = (m_samples[i].ref.rot.transpose() * rot * m_samples[i].target.rot);
-		Eigen::Quaterniond quatExtTmp(rotExtTmp);
-		quatExtTmp.normalize();
-		coefficients.block<4, 4>(4 * i, 0) = Eigen::Matrix4d::Identity();
-		constraints.block<4, 1>(4 * i, 0) = Eigen::Vector4d(quatExtTmp.w(), quatExtTmp.x(), quatExtTmp.y(), quatExtTmp.z());
-	}
-	Eigen::Vector4d result = coefficients.bdcSvd(Eigen::ComputeThinU | Eigen::ComputeThinV).solve(constraints);
-	Eigen::Quaterniond quatExt(result(0), result(1), result(2), result(3));
-	quatExt.normalize();
-	Eigen::Matrix3d extRot = quatExt.toRotationMatrix();
+	// Optimize an extrinsic from reference to target, as the average of the extrinsics implied by each sample.
+	// Detect the outliers by comparing the extrinsic computed from each sample to the averaged extrinsic.
+	const Eigen::Quaterniond rotQuat(rot);
+	const auto sampleExtrinsic = [&](size_t i) {
+		return (m_samples.RefQuat(i).conjugate() * rotQuat * m_samples.TargetQuat(i)).normalized();
+	};
+
+	QuaternionMoments extrinsics;
+	for (size_t i = 0; i < m_samples.Size(); i++) {
+		extrinsics.Add(sampleExtrinsic(i));
+	}
+	const Eigen::Quaterniond quatExt = extrinsics.Mean();
 	const double threshold = 0.99;
 
-	for (size_t i = 0; i < m_samples.size(); i++) {
-		Eigen::Matrix3d rotExtTmp = (m_samples[i].ref.rot.transpose() * rot * m_samples[i].target.rot);
-		Eigen::Quaterniond quatExtTmp(rotExtTmp);
-		double cosHalfAngle = quatExtTmp.w() * quatExt.w() + quatExtTmp.vec().dot(quatExt.vec());
-		if (abs(cosHalfAngle) < threshold) {
-			valids[i] = false;
-		} else {
-			valids[i] = true;
-		}
+	std::vector<bool> valids(m_samples.Size());
+	for (size_t i = 0; i < m_samples.Size(); i++) {
+		double cosHalfAngle = sampleExtrinsic(i).dot(quatExt);
+		valids[i] = abs(cosHalfAngle) >= threshold;
 	}
 	return valids;
 }
 
 Eigen::Vector3d CalibrationCalc::CalibrateRotation(const bool ignoreOutliers) const {
-	std::vector<DSample> deltas;
-	std::vector<bool> valids = DetectOutliers();
+	std::vector<bool> valids;
+	if (ignoreOutliers) {
+		valids = DetectOutliers();
+	}
 
-	for (size_t i = 0; i < m_samples.size(); i++) {
-		for (size_t j = 0; j < i; j++) {
-			if ( ignoreOutliers && (!valids[i] || !valids[j])) {
-				continue;
-			}
-			auto delta = DeltaRotationSamples(m_samples[i], m_samples[j]);
-			if (delta.valid) {
-				deltas.push_back(delta);
+	DeltaRotationAccumulator pairs;
+	if (solverMode == SolverMode::AllPairs) {
+		pairs = ReduceTriangle<DeltaRotationAccumulator>(m_samples.Size(), parallelSolve, [&](DeltaRotationAccumulator& acc, size_t i) {
+			if (ignoreOutliers && !valids[i]) return;
+
+			ForEachRotationDelta(m_samples, i, 0, i, [&](size_t j, const DSample& delta) {
+				if (ignoreOutliers && !valids[j]) return;
+				acc.Add(delta.ref, delta.target);
+			});
+		}, &m_budget);
+	} else {
+		pairs = m_rotationPairs;
+
+		if (ignoreOutliers) {
+			std::vector<size_t> outliers;
+			for (size_t i = 0; i < m_samples.Size(); i++) {
+				if (!valids[i]) outliers.push_back(i);
 			}
+
+			// Take out every pair involving an outlier. Pairs between two outliers are only removed once.
+			const size_t work = outliers.size() * m_samples.Size();
+			pairs -= ReduceRows<DeltaRotationAccumulator>(outliers.size(), false, work, parallelSolve, [&](DeltaRotationAccumulator& acc, size_t row) {
+				const size_t i = outliers[row];
+
+				ForEachRotationDelta(m_samples, i, 0, m_samples.Size(), [&](size_t j, const DSample& delta) {
+					if (!valids[j] && j < i) return;
+					acc.Add(delta.ref, delta.target);
+				});
+			}, &m_budget);
 		}
 	}
 	//char buf[256];
-	//snprintf(buf, sizeof buf, "Got %zd samples with %zd delta samples\n", m_samples.size(), deltas.size());
+	//snprintf(buf, sizeof buf, "Got %zd samples with %zd delta samples\n", m_samples.Size(), pairs.Count());
 	//CalCtx.Log(buf);
 
 	// Kabsch algorithm
 
-	// Initialize 2D points and centroids
-	Eigen::MatrixXd refPoints(deltas.size(), 2), targetPoints(deltas.size(), 2);
-	Eigen::Vector2d refCentroid(0, 0), targetCentroid(0, 0);
-
-	// Fill matrices and calculate centroids
-	for (size_t i = 0; i < deltas.size(); i++) {
-		refPoints.row(i) << deltas[i].ref[0], deltas[i].ref[2];  // Take only the x and z components
-		refCentroid += refPoints.row(i);
-
-		targetPoints.row(i) << deltas[i].target[0], deltas[i].target[2];  // Take only the x and z components
-		targetCentroid += targetPoints.row(i);
-	}
-
-	refCentroid /= (double)deltas.size();
-	targetCentroid /= (double)deltas.size();
-
-	// Center the points
-	for (size_t i = 0; i < deltas.size(); i++) {
-		refPoints.row(i) -= refCentroid;
-		targetPoints.row(i) -= targetCentroid;
-	}
-
-	// Calculate cross-covariance matrix
-	auto crossCV = refPoints.transpose() * targetPoints;
+	// Calculate the cross-covariance matrix of the centered axes, taking only the x and z components
+	const Eigen::Matrix3d crossCV3 = pairs.CrossCovariance();
+	Eigen::Matrix2d crossCV;
+	crossCV << crossCV3(0, 0), crossCV3(0, 2),
+		crossCV3(2, 0), crossCV3(2, 2);
 
 	// Singular Value Decomposition (SVD)
-	Eigen::JacobiSVD<Eigen::MatrixXd> svd(crossCV, Eigen::ComputeThinU | Eigen::ComputeThinV);
+	Eigen::JacobiSVD<Eigen::Matrix2d> svd(crossCV, Eigen::ComputeFullU | Eigen::ComputeFullV);
 
 	// Calculate 2D rotation matrix
 	Eigen::Matrix2d i = Eigen::Matrix2d::Identity();
@@ -265,47 +506,41 @@ Eigen::Vector3d CalibrationCalc::CalibrateRotation(const bool ignoreOutliers) co
 
 Eigen::Vector3d CalibrationCalc::CalibrateTranslation(const Eigen::Matrix3d &rotation) const
 {
-	std::vector<std::pair<Eigen::Vector3d, Eigen::Matrix3d>> deltas;
+	if (solverMode == SolverMode::AllPairs) {
+		return CalibrateTranslationAllPairs(rotation);
+	}
 
-	for (size_t i = 0; i < m_samples.size(); i++)
-	{
-		Sample s_i = m_samples[i];
-		s_i.target.rot = rotation * s_i.target.rot;
-		s_i.target.trans = rotation * s_i.target.trans;
+	// Same least-squares problem as the all-pairs path, solved from the running normal equations.
+	return m_translationAccum.Solve(rotation);
+}
 
-		for (size_t j = 0; j < i; j++)
-		{
-			Sample s_j = m_samples[j];
-			s_j.target.rot = rotation * s_j.target.rot;
-			s_j.target.trans = rotation * s_j.target.trans;
-			
-			auto QAi = s_i.ref.rot.transpose();
-			auto QAj = s_j.ref.rot.transpose();
-			auto dQA = QAj - QAi;
-			auto CA = QAj * (s_j.ref.trans - s_j.target.trans) - QAi * (s_i.ref.trans - s_i.target.trans);
-			deltas.push_back(std::make_pair(CA, dQA));
-
-			auto QBi = s_i.target.rot.transpose();
-			auto QBj = s_j.target.rot.transpose();
-			auto dQB = QBj - QBi;
-			auto CB = QBj * (s_j.ref.trans - s_j.target.trans) - QBi * (s_i.ref.trans - s_i.target.trans);
-			deltas.push_back(std::make_pair(CB, dQB));
-		}
+Eigen::Vector3d CalibrationCalc::CalibrateTranslationAllPairs(const Eigen::Matrix3d &rotation) const
+{
+	// Each pair contributes two 3x3 constraint blocks; accumulate their normal equations rather than stacking
+	// them into one (6 * N^2 / 2) x 3 system.
+	std::vector<TranslationTerms> terms(m_samples.Size());
+	for (size_t i = 0; i < m_samples.Size(); i++) {
+		auto& term = terms[i];
+		const Eigen::Vector3d v = m_samples.RefTrans(i) - rotation * m_samples.TargetTrans(i);
+
+		term.QA = m_samples.RefRot(i).transpose();
+		term.QB = (rotation * m_samples.TargetRot(i)).transpose();
+		term.QAv = term.QA * v;
+		term.QBv = term.QB * v;
 	}
 
-	Eigen::VectorXd constants(deltas.size() * 3);
-	Eigen::MatrixXd coefficients(deltas.size() * 3, 3);
+	auto system = ReduceTriangle<NormalEquations3>(m_samples.Size(), parallelSolve, [&](NormalEquations3& acc, size_t i) {
+		const auto& ti = terms[i];
 
-	for (size_t i = 0; i < deltas.size(); i++)
-	{
-		for (int axis = 0; axis < 3; axis++)
+		for (size_t j = 0; j < i; j++)
 		{
-			constants(i * 3 + axis) = deltas[i].first(axis);
-			coefficients.row(i * 3 + axis) = deltas[i].second.row(axis);
+			const auto& tj = terms[j];
+			acc.Add(tj.QA - ti.QA, tj.QAv - ti.QAv);
+			acc.Add(tj.QB - ti.QB, tj.QBv - ti.QBv);
 		}
-	}
+	}, &m_budget);
 
-	Eigen::Vector3d trans = coefficients.bdcSvd(Eigen::ComputeThinU | Eigen::ComputeThinV).solve(constants);
+	Eigen::Vector3d trans = Eigen::JacobiSVD<Eigen::Matrix3d>(system.AtA, Eigen::ComputeFullU | Eigen::ComputeFullV).solve(system.Atb);
 	auto transcm = trans * 100.0;
 
 	//char buf[256];
@@ -348,117 +583,105 @@ Eigen::AffineCompact3d CalibrationCalc::ComputeCalibration(const bool ignoreOutl
 
 
 
-double CalibrationCalc::RetargetingErrorRMS(
-	const Eigen::Vector3d& hmdToTargetPos,
-	const Eigen::AffineCompact3d& calibration
-) const {
-	double errorAccum = 0;
-	int sampleCount = 0;
-
-	for (auto& sample : m_samples) {
-		if (!sample.valid) continue;
-
-		// Apply transformation
-		const auto updatedPose = ApplyTransform(sample.target, calibration);
-
-		const Eigen::Vector3d hmdPoseSpace = sample.ref.rot * hmdToTargetPos + sample.ref.trans;
+/*
+ * Refines the calibration in place with Levenberg-Marquardt steps on the retargeting residual, starting from its
+ * current value. The reference-to-target offset is estimated alongside, and eliminated from each step with a
+ * Schur complement, leaving a 6x6 system of which only the yaw and translation are solved for, as in the closed
+ * form; pitch and roll are left as they are. Every iteration works on the running sums, so this doesn't touch the
+ * samples at all; the flip side is that outliers aren't excluded, and a result they drag off is left for
+ * validation to reject. Returns false if the window doesn't constrain the problem.
+ */
+bool CalibrationCalc::RefineCalibration(Eigen::AffineCompact3d& calibration) const {
+	const double n = (double)m_retargetAccum.Count();
+	if (n == 0) return false;
+
+	Eigen::Vector3d offset = m_retargetAccum.BestOffset(calibration);
+	double cost = m_retargetAccum.Cost(calibration, offset);
+
+	RetargetingAccumulator::Matrix6d Hxx;
+	RetargetingAccumulator::Matrix63d Hxp;
+	RetargetingAccumulator::Vector6d gx;
+	Eigen::Vector3d gp;
+	m_retargetAccum.Linearize(calibration, offset, Hxx, Hxp, gx, gp);
+
+	double lambda = 1e-3;
+	for (int iteration = 0; iteration < MaxRefineIterations; iteration++) {
+		// Eliminate the offset, keep the yaw and translation rows, then damp the reduced system
+		const RetargetingAccumulator::Matrix6d H = Hxx - Hxp * Hxp.transpose() / n;
+		const RetargetingAccumulator::Vector6d g = gx - Hxp * gp / n;
+
+		Eigen::Matrix4d Hr;
+		Eigen::Vector4d gr;
+		for (int i = 0; i < 4; i++) {
+			for (int j = 0; j < 4; j++) {
+				Hr(i, j) = H(YawTranslationRows[i], YawTranslationRows[j]);
+			}
+			gr(i) = g(YawTranslationRows[i]);
+		}
+		Hr.diagonal() *= 1.0 + lambda;
 
-		// Compute error term
-		double error = (updatedPose.trans - hmdPoseSpace).squaredNorm();
-		errorAccum += error;
-		sampleCount++;
-	}
+		const Eigen::Vector4d dr = Hr.ldlt().solve(-gr);
+		if (!dr.allFinite()) return false;
 
-	return sqrt(errorAccum / sampleCount);
-}
+		RetargetingAccumulator::Vector6d dx = RetargetingAccumulator::Vector6d::Zero();
+		for (int i = 0; i < 4; i++) {
+			dx(YawTranslationRows[i]) = dr(i);
+		}
+		const Eigen::Vector3d dp = (-gp - Hxp.transpose() * dx) / n;
 
-double CalibrationCalc::ReferenceJitter() const {
-	Eigen::Vector3d m_oldM, m_newM, m_oldS, m_newS;
-	int sampleCount = 0;
+		Eigen::AffineCompact3d candidate;
+		candidate.linear() = Eigen::AngleAxisd(dx(1), Eigen::Vector3d::UnitY()).toRotationMatrix() * calibration.linear();
+		candidate.translation() = calibration.translation() + dx.tail<3>();
 
-	for (auto& sample : m_samples) {
-		if (!sample.valid) continue;
+		const double candidateCost = m_retargetAccum.Cost(candidate, offset + dp);
+		if (candidateCost < cost) {
+			calibration = candidate;
+			offset += dp;
+			cost = candidateCost;
+			lambda *= 0.1;
 
-		if (sampleCount == 0) {
-			m_oldM = m_newM = sample.ref.trans;
-			m_oldS = Eigen::Vector3d();
+			if (dx.norm() < 1e-9) break;
+			m_retargetAccum.Linearize(calibration, offset, Hxx, Hxp, gx, gp);
 		} else {
-			m_newM = m_oldM + (sample.ref.trans - m_oldM) / sampleCount;
-			m_newS = m_oldS + (sample.ref.trans - m_oldM).cwiseProduct(sample.ref.trans - m_newM);
-
-			// set up for next iteration
-			m_oldM = m_newM;
-			m_oldS = m_newS;
+			lambda *= 10.0;
 		}
-
-		sampleCount++;
 	}
 
-	double var_x = sqrt(((sampleCount > 1) ? m_newS.x() / (sampleCount - 1) : 0.0));
-	double var_y = sqrt(((sampleCount > 1) ? m_newS.y() / (sampleCount - 1) : 0.0));
-	double var_z = sqrt(((sampleCount > 1) ? m_newS.z() / (sampleCount - 1) : 0.0));
-
-	// Take magnitude of standard deviation vector
-	return sqrt(var_x * var_x + var_y * var_y + var_z * var_z);
+	return true;
 }
 
-double CalibrationCalc::TargetJitter() const {
-	Eigen::Vector3d m_oldM, m_newM, m_oldS, m_newS;
-	int sampleCount = 0;
-
-	for (auto& sample : m_samples) {
-		if (!sample.valid) continue;
-
-		if (sampleCount == 0) {
-			m_oldM = m_newM = sample.target.trans;
-			m_oldS = Eigen::Vector3d();
-		}
-		else {
-			m_newM = m_oldM + (sample.target.trans - m_oldM) / sampleCount;
-			m_newS = m_oldS + (sample.target.trans - m_oldM).cwiseProduct(sample.target.trans - m_newM);
-
-			// set up for next iteration
-			m_oldM = m_newM;
-			m_oldS = m_newS;
-		}
-
-		sampleCount++;
-	}
-
-	double var_x = sqrt(((sampleCount > 1) ? std::abs(m_newS.x() / (sampleCount - 1)) : 0.0));
-	double var_y = sqrt(((sampleCount > 1) ? std::abs(m_newS.y() / (sampleCount - 1)) : 0.0));
-	double var_z = sqrt(((sampleCount > 1) ? std::abs(m_newS.z() / (sampleCount - 1)) : 0.0));
+double CalibrationCalc::ResidualMoments::ErrorRMS(const Eigen::Vector3d& offset) const {
+	const double meanSquared = squaredNorm / count - 2.0 * offset.dot(sum) / count + offset.squaredNorm();
 
-	// Take magnitude of standard deviation vector
-	return sqrt(var_x * var_x + var_y * var_y + var_z * var_z);
+	// The expansion can come out slightly negative through cancellation when the error is tiny.
+	return sqrt(std::max(meanSquared, 0.0));
 }
 
-Eigen::Vector3d CalibrationCalc::ComputeRefToTargetOffset(const Eigen::AffineCompact3d& calibration) const {
-	Eigen::Vector3d accum = Eigen::Vector3d::Zero();
-	int sampleCount = 0;
-
-	for (auto& sample : m_samples) {
-		if (!sample.valid) continue;
+void CalibrationCalc::EvaluateResiduals(
+	const Eigen::AffineCompact3d* calibrations,
+	ResidualMoments* out,
+	size_t count
+) const {
+	for (size_t k = 0; k < count; k++) {
+		out[k] = ResidualMoments();
+	}
 
-		// Apply transformation
-		const auto updatedPose = ApplyTransform(sample.target, calibration);
+	for (size_t i = 0; i < m_samples.Size(); i++) {
+		if (!m_samples.Valid(i)) continue;
 
-		// Now move the transform from world to HMD space
-		const auto hmdOriginPos = updatedPose.trans - sample.ref.trans;
-		const auto hmdSpace = sample.ref.rot.inverse() * hmdOriginPos;
+		const Eigen::Matrix3d& refRot = m_samples.RefRot(i);
+		const Eigen::Vector3d& refTrans = m_samples.RefTrans(i);
+		const Eigen::Vector3d& targetTrans = m_samples.TargetTrans(i);
 
-		accum += hmdSpace;
-		sampleCount++;
+		for (size_t k = 0; k < count; k++) {
+			// Apply the candidate, then move from world to HMD space
+			const Eigen::Vector3d updatedTrans = calibrations[k] * targetTrans;
+			out[k].Add(refRot.transpose() * (updatedTrans - refTrans));
+		}
 	}
-
-	accum /= sampleCount;
-
-	return accum;
 }
 
-Eigen::Vector4d CalibrationCalc::ComputeAxisVariance(
-	const Eigen::AffineCompact3d& calibration
-) const {
+Eigen::Vector4d CalibrationCalc::ComputeAxisVariance() const {
 	// We want to determine if the user rotated in enough axis to find a unique solution.
 	// It's sufficient to rotate in two axis - this is because once we constrain the mapping
 	// of those two orthogonal basis vectors, the third is determined by the cross product of
@@ -470,34 +693,10 @@ Eigen::Vector4d CalibrationCalc::ComputeAxisVariance(
 	// we expect that rotations around a single axis will have two primary components: One corresponding
 	// to the identity component, and one to the axis component. Thus, we check the variance (eigenvalue) of
 	// the third primary component to see if we've moved in two axis.
-	std::ostringstream dbgStream;
-
-	std::vector<Eigen::Vector4d> points;
-
-	Eigen::Vector4d mean = Eigen::Vector4d::Zero();
-
-	for (auto& sample : m_samples) {
-		if (!sample.valid) continue;
-
-		auto q = Eigen::Quaterniond(sample.target.rot);
-		auto point = Eigen::Vector4d(q.w(), q.x(), q.y(), q.z());
-		mean += point;
-
-		points.push_back(point);
-	}
-	mean /= (double) points.size();
-
-	// Compute covariance matrix
-	Eigen::Matrix4d covMatrix = Eigen::Matrix4d::Zero();
-
-	for (auto& point : points) {
-		for (int i = 0; i < 4; i++) {
-			for (int j = 0; j < 4; j++) {
-				covMatrix(i, j) += (point(i) - mean(i)) * (point(j) - mean(j));
-			}
-		}
-	}
-	covMatrix /= (double) points.size();
+	//
+	// The target quaternion moments are kept up to date as samples come and go, so this is a single 4x4 eigen
+	// solve regardless of the window size.
+	const Eigen::Matrix4d covMatrix = m_targetJitter.Rotations().Covariance();
 
 	Eigen::SelfAdjointEigenSolver<Eigen::Matrix4d> solver;
 	solver.compute(covMatrix);
@@ -506,9 +705,16 @@ Eigen::Vector4d CalibrationCalc::ComputeAxisVariance(
 }
 
 [[nodiscard]] bool CalibrationCalc::ValidateCalibration(const Eigen::AffineCompact3d &calibration, double *error, Eigen::Vector3d *posOffsetV) {
+	ResidualMoments residuals;
+	EvaluateResiduals(&calibration, &residuals, 1);
+
+	return ValidateCalibration(residuals, error, posOffsetV);
+}
+
+[[nodiscard]] bool CalibrationCalc::ValidateCalibration(const ResidualMoments &residuals, double *error, Eigen::Vector3d *posOffsetV) {
 	bool ok = true;
 
-	const auto posOffset = ComputeRefToTargetOffset(calibration);
+	const auto posOffset = residuals.Offset();
 
 	if (posOffsetV) *posOffsetV = posOffset;
 
@@ -516,7 +722,7 @@ Eigen::Vector4d CalibrationCalc::ComputeAxisVariance(
 	//snprintf(buf, sizeof buf, "HMD to target offset: (%.2f, %.2f, %.2f)\n", posOffset(0), posOffset(1), posOffset(2));
 	//CalCtx.Log(buf);
 
-	double rmsError = RetargetingErrorRMS(posOffset, calibration);
+	double rmsError = residuals.ErrorRMS(posOffset);
 	//snprintf(buf, sizeof buf, "Position error (RMS): %.3f\n", rmsError);
 	//CalCtx.Log(buf);
 	if (rmsError > 0.1) ok = false;
@@ -539,67 +745,52 @@ Eigen::Vector4d CalibrationCalc::ComputeAxisVariance(
 // R * S * T^-1 = C
 
 namespace {
+	/*
+	 * Averages rigid poses in constant memory: rotations through the running quaternion moments, translations
+	 * through a running sum.
+	 */
 	class PoseAverager {
 	private:
-		Eigen::Matrix<double, 4, Eigen::Dynamic> quatAvg;
+		QuaternionMoments rotations;
 		Eigen::Vector3d accum = Eigen::Vector3d::Zero();
-		int i = 0;
 	public:
-		PoseAverager(size_t n_samples) {
-			quatAvg.resize(4, n_samples);
-		}
-
-		template<typename P>
-		void Push(const P &pose) {
-			const Eigen::Quaterniond rot(pose.rotation());
-			quatAvg.col(i++) = Eigen::Vector4d(rot.w(), rot.x(), rot.y(), rot.z());
-			accum += pose.translation();
+		void Push(const Eigen::Quaterniond& rot, const Eigen::Vector3d& trans) {
+			rotations.Add(rot);
+			accum += trans;
 		}
 
-		Eigen::AffineCompact3d Average() {
-			// https://stackoverflow.com/a/27410865/36723
-			auto quatT = quatAvg.transpose();
-			Eigen::Matrix4d quatMul = quatAvg * quatT;
-			Eigen::SelfAdjointEigenSolver<Eigen::Matrix4d> solver;
-			solver.compute(quatMul);
-
-			Eigen::Vector4d quatAvgV = solver.eigenvectors().col(3).real().normalized();
-			Eigen::Quaterniond avgQ(quatAvgV(0), quatAvgV(1), quatAvgV(2), quatAvgV(3));
-			avgQ.normalize();
-
-			Eigen::AffineCompact3d pose(avgQ);
-			pose.pretranslate(accum * (1.0 / i));
+		Eigen::AffineCompact3d Average() const {
+			Eigen::AffineCompact3d pose(rotations.Mean().normalized());
+			pose.pretranslate(accum * (1.0 / rotations.Count()));
 
 			return pose;
 		}
 
-		template<typename XS, typename F>
-		static Eigen::AffineCompact3d AverageFor(const XS& samples, const F& poseProvider) {
-			int sampleCount = 0;
-
-			for (auto& sample : samples) {
-				if (!sample.valid) continue;
+		// Calls poseProvider(averager, index) for each valid sample, which should Push() that sample's pose.
+		template<typename F>
+		static Eigen::AffineCompact3d AverageFor(const SampleBuffer& samples, const F& poseProvider) {
+			PoseAverager averager;
 
-				sampleCount++;
+			for (size_t i = 0; i < samples.Size(); i++) {
+				if (!samples.Valid(i)) continue;
+				poseProvider(averager, i);
 			}
 
-			PoseAverager accum(sampleCount);
-
-			for (auto& sample : samples) {
-				if (!sample.valid) continue;
-				auto pose = poseProvider(sample);
-				accum.Push(pose);
-			}
-
-			return accum.Average();
+			return averager.Average();
 		}
 	};
 }
 
 // S = R^-1 * C * T
 Eigen::AffineCompact3d CalibrationCalc::EstimateRefToTargetPose(const Eigen::AffineCompact3d &calibration) const {
-	auto avg = PoseAverager::AverageFor(m_samples, [&](const auto& sample) {
-		return Eigen::Affine3d(sample.ref.ToAffine().inverse() * calibration * sample.target.ToAffine());
+	const Eigen::Quaterniond calibrationRot(calibration.rotation());
+
+	auto avg = PoseAverager::AverageFor(m_samples, [&](PoseAverager& averager, size_t i) {
+		// The reference pose is rigid, so its inverse is just the transposed rotation.
+		averager.Push(
+			m_samples.RefQuat(i).conjugate() * calibrationRot * m_samples.TargetQuat(i),
+			m_samples.RefRot(i).transpose() * (calibration * m_samples.TargetTrans(i) - m_samples.RefTrans(i))
+		);
 	});
 
 #if 0
@@ -627,8 +818,15 @@ Eigen::AffineCompact3d CalibrationCalc::EstimateRefToTargetPose(const Eigen::Aff
  */
 bool CalibrationCalc::CalibrateByRelPose(Eigen::AffineCompact3d &out) const {
 	// R * S * T^-1 = C
-	out = PoseAverager::AverageFor(m_samples, [&](const auto& sample) {
-		return Eigen::AffineCompact3d(sample.ref.ToAffine() * m_refToTargetPose * sample.target.ToAffine().inverse());
+	const Eigen::Quaterniond refToTargetRot(m_refToTargetPose.rotation());
+
+	out = PoseAverager::AverageFor(m_samples, [&](PoseAverager& averager, size_t i) {
+		// Expanding the rigid inverse of T: C = (Rr * Rs * Rt^T, tr + Rr * ts - (Rr * Rs * Rt^T) * tt)
+		const Eigen::Quaterniond rot = m_samples.RefQuat(i) * refToTargetRot * m_samples.TargetQuat(i).conjugate();
+		averager.Push(
+			rot,
+			m_samples.RefTrans(i) + m_samples.RefRot(i) * m_refToTargetPose.translation() - rot * m_samples.TargetTrans(i)
+		);
 	});
 
 	return true;
@@ -637,9 +835,19 @@ bool CalibrationCalc::CalibrateByRelPose(Eigen::AffineCompact3d &out) const {
 
 
 bool CalibrationCalc::ComputeOneshot(const bool ignoreOutliers) {
+	m_budget = SolveBudget(solveBudget);
 	auto calibration = ComputeCalibration(ignoreOutliers);
+	m_report.Push(Metrics::solveCoverage, m_budget.Coverage());
+
+	if (m_budget.Coverage() < MinSolveCoverage) {
+		Log("Not updating: Solve ran out of time\n");
+		return false;
+	}
 
-	bool valid = ValidateCalibration(calibration);
+	bool valid = ValidateCalibration(calibration, &m_lastSolveError);
+
+	m_axisVariance = ComputeAxisVariance()(1);
+	EstimateUncertainty(calibration);
 
 	if (valid) {
 		m_estimatedTransformation = calibration; // @NOTE: Normal calibration
@@ -647,13 +855,60 @@ bool CalibrationCalc::ComputeOneshot(const bool ignoreOutliers) {
 		return true;
 	}
 	else {
-		CalCtx.Log("Not updating: Low-quality calibration result\n");
+		Log("Not updating: Low-quality calibration result\n");
 		return false;
 	}
 }
 
+void CalibrationCalc::EstimateUncertainty(const Eigen::AffineCompact3d& calibration) {
+	m_translationSigma = INFINITY;
+	m_rotationSigma = INFINITY;
+
+	// Each sample gives three residuals; the yaw, translation and offset take seven
+	const double n = (double)m_retargetAccum.Count();
+	if (n * 3 <= 7) return;
+
+	const Eigen::Vector3d offset = m_retargetAccum.BestOffset(calibration);
+	const double variance = 2.0 * m_retargetAccum.Cost(calibration, offset) / (n * 3 - 7);
+
+	RetargetingAccumulator::Matrix6d Hxx;
+	RetargetingAccumulator::Matrix63d Hxp;
+	RetargetingAccumulator::Vector6d gx;
+	Eigen::Vector3d gp;
+	m_retargetAccum.Linearize(calibration, offset, Hxx, Hxp, gx, gp);
+
+	// The one-shot solve only finds the yaw (about y) besides the translation, so keep just those rows of the
+	// information matrix, with the offset marginalized out by the Schur complement.
+	const RetargetingAccumulator::Matrix6d reduced = Hxx - Hxp * Hxp.transpose() / n;
+	Eigen::Matrix4d information;
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			information(i, j) = reduced(YawTranslationRows[i], YawTranslationRows[j]);
+		}
+	}
+
+	Eigen::SelfAdjointEigenSolver<Eigen::Matrix4d> eigen(information);
+	if (eigen.eigenvalues()(0) <= 0) return;
+
+	const Eigen::Matrix4d covariance = variance * eigen.eigenvectors()
+		* eigen.eigenvalues().cwiseInverse().asDiagonal() * eigen.eigenvectors().transpose();
+
+	// The translation is solved for the rotation found from the orientations, so its spread is taken with the yaw
+	// held fixed. The yaw's own spread here only counts the positions, so it errs on the large side.
+	Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> translation(information.bottomRightCorner<3, 3>(), Eigen::EigenvaluesOnly);
+	m_rotationSigma = sqrt(std::max(covariance(0, 0), 0.0));
+	m_translationSigma = sqrt(variance / translation.eigenvalues()(0));
+}
+
+bool CalibrationCalc::Converged() const {
+	return m_isValid
+		&& m_axisVariance >= AxisVarianceThreshold
+		&& m_translationSigma <= MaxConvergedTranslationSigma
+		&& m_rotationSigma <= MaxConvergedRotationSigma;
+}
+
 void CalibrationCalc::ComputeInstantOffset() {
-	const auto &latestSample = m_samples.back();
+	const Sample latestSample = m_samples.At(m_samples.Size() - 1);
 
 	// Apply transformation
 	const auto updatedPose = ApplyTransform(latestSample.target, m_estimatedTransformation);
@@ -662,47 +917,53 @@ void CalibrationCalc::ComputeInstantOffset() {
 	const auto hmdOriginPos = updatedPose.trans - latestSample.ref.trans;
 	const auto hmdSpace = latestSample.ref.rot.inverse() * hmdOriginPos;
 	
-	Metrics::posOffset_lastSample.Push(hmdSpace * 1000);
+	m_report.Push(Metrics::posOffset_lastSample, hmdSpace * 1000);
 }
 
 bool CalibrationCalc::ComputeIncremental(bool &lerp, double threshold, double relPoseMaxError, const bool ignoreOutliers) {
-	Metrics::RecordTimestamp();
+	Eigen::AffineCompact3d byRelPose = Eigen::AffineCompact3d::Identity();
+	const bool haveRelPose = (lockRelativePosition || enableStaticRecalibration) && CalibrateByRelPose(byRelPose);
+
+	// Score the current calibration and the relative pose estimate together, in a single pass over the window.
+	const Eigen::AffineCompact3d candidates[] = { m_estimatedTransformation, byRelPose };
+	ResidualMoments residuals[2];
+	EvaluateResiduals(candidates, residuals, haveRelPose ? 2 : 1);
+	const ResidualMoments& priorResiduals = residuals[0];
+	const ResidualMoments& relPoseResiduals = residuals[1];
 
-	if (lockRelativePosition) {
-		Eigen::AffineCompact3d byRelPose;
+	if (lockRelativePosition && haveRelPose) {
 		double relPoseError = INFINITY;
 		Eigen::Vector3d relPosOffset;
-		if (CalibrateByRelPose(byRelPose) &&
-			ValidateCalibration(byRelPose, &relPoseError, &relPosOffset)) {
+		if (ValidateCalibration(relPoseResiduals, &relPoseError, &relPosOffset)) {
 
-			Metrics::posOffset_byRelPose.Push(relPosOffset * 1000);
-			Metrics::error_byRelPose.Push(relPoseError * 1000);
+			m_report.Push(Metrics::posOffset_byRelPose, relPosOffset * 1000);
+			m_report.Push(Metrics::error_byRelPose, relPoseError * 1000);
 
 			m_isValid = true;
 			m_estimatedTransformation = byRelPose;
+			m_lastSolveError = relPoseError;
 			return true;
 		}
 	}
 
 	double priorCalibrationError = INFINITY;
 	Eigen::Vector3d priorPosOffset;
-	if (m_isValid && ValidateCalibration(m_estimatedTransformation, &priorCalibrationError, &priorPosOffset)) {
-		Metrics::posOffset_currentCal.Push(priorPosOffset * 1000);
-		Metrics::error_currentCal.Push(priorCalibrationError * 1000);
+	if (m_isValid && ValidateCalibration(priorResiduals, &priorCalibrationError, &priorPosOffset)) {
+		m_report.Push(Metrics::posOffset_currentCal, priorPosOffset * 1000);
+		m_report.Push(Metrics::error_currentCal, priorCalibrationError * 1000);
 	}
 
 	double newError = INFINITY;
 	bool newCalibrationValid = false;
-	Eigen::AffineCompact3d byRelPose;
 	Eigen::AffineCompact3d calibration;
 	bool usingRelPose = false;
 	double relPoseError = INFINITY;
 
-	if (enableStaticRecalibration && CalibrateByRelPose(byRelPose)) {
+	if (enableStaticRecalibration && haveRelPose) {
 		Eigen::Vector3d relPosOffset;
-		if (ValidateCalibration(byRelPose, &relPoseError, &relPosOffset)) {
-			Metrics::posOffset_byRelPose.Push(relPosOffset * 1000);
-			Metrics::error_byRelPose.Push(relPoseError * 1000);
+		if (ValidateCalibration(relPoseResiduals, &relPoseError, &relPosOffset)) {
+			m_report.Push(Metrics::posOffset_byRelPose, relPosOffset * 1000);
+			m_report.Push(Metrics::error_byRelPose, relPoseError * 1000);
 
 			if (relPoseError < 0.010 || m_relativePosCalibrated && relPoseError < 0.025) {
 				if (relPoseError * threshold >= priorCalibrationError) {
@@ -724,17 +985,35 @@ bool CalibrationCalc::ComputeIncremental(bool &lerp, double threshold, double re
 	double newVariance = 0;
 	bool shouldRapidCorrect = true;
 	if (!newCalibrationValid) {
-		calibration = ComputeCalibration(ignoreOutliers);
-
-		newVariance = ComputeAxisVariance(calibration)(1);
-		Metrics::axisIndependence.Push(newVariance);
+		// The axis variance only depends on the window, so it can rule out the full solve before we pay for it.
+		newVariance = ComputeAxisVariance()(1);
+		m_report.Push(Metrics::axisIndependence, newVariance);
 
 		if (newVariance < AxisVarianceThreshold && newVariance < m_axisVariance) {
 			newCalibrationValid = false;
 			shouldRapidCorrect = false;
 		} else {
-			newCalibrationValid = ValidateCalibration(calibration, &newError, &m_posOffset);
-			Metrics::posOffset_rawComputed.Push(m_posOffset * 1000);
+			// While the current calibration fits about as well as it did after the last solve, it only needs refining.
+			bool refined = false;
+			if (continuousEngine == ContinuousEngine::Refine && m_isValid &&
+				priorCalibrationError < m_lastSolveError * RefineJumpRatio) {
+				calibration = m_estimatedTransformation;
+				refined = RefineCalibration(calibration);
+			}
+
+			m_budget = SolveBudget(solveBudget);
+			if (!refined) {
+				calibration = ComputeCalibration(ignoreOutliers);
+			}
+			m_report.Push(Metrics::solveCoverage, m_budget.Coverage());
+
+			if (m_budget.Coverage() < MinSolveCoverage) {
+				// Too rough to judge against the current calibration; keep it, but still allow a rapid correction.
+				newCalibrationValid = false;
+			} else {
+				newCalibrationValid = ValidateCalibration(calibration, &newError, &m_posOffset);
+				m_report.Push(Metrics::posOffset_rawComputed, m_posOffset * 1000);
+			}
 		}
 
 		if (m_isValid) {
@@ -745,7 +1024,7 @@ bool CalibrationCalc::ComputeIncremental(bool &lerp, double threshold, double re
 			}
 		}
 
-		Metrics::error_rawComputed.Push(newError * 1000);
+		m_report.Push(Metrics::error_rawComputed, newError * 1000);
 		
 		ComputeInstantOffset();
 	}
@@ -757,15 +1036,15 @@ bool CalibrationCalc::ComputeIncremental(bool &lerp, double threshold, double re
 		char tmp[256];
 		snprintf(tmp, sizeof tmp, "Prior calibration error: %.3f (valid: %s) sct %d; new error %.3f; new better? %s\n",
 			priorCalibrationError, m_isValid ? "yes" : "no", stableCt, newError, !oldCalibrationBetter ? "yes" : "no");
-		CalCtx.Log(tmp);
+		Log(tmp);
 #endif
 		
 	
 	// Now, can we use the relative pose to perform a rapid correction?
 	if (!newCalibrationValid && shouldRapidCorrect) {
 		
-		double existingPoseErrorUsingRelPosition = RetargetingErrorRMS(m_refToTargetPose.translation(), m_estimatedTransformation);
-		Metrics::error_currentCalRelPose.Push(existingPoseErrorUsingRelPosition * 1000);
+		double existingPoseErrorUsingRelPosition = priorResiduals.ErrorRMS(m_refToTargetPose.translation());
+		m_report.Push(Metrics::error_currentCalRelPose, existingPoseErrorUsingRelPosition * 1000);
 		if (relPoseError * threshold < existingPoseErrorUsingRelPosition || newCalibrationValid && relPoseError < newError) {
 			newCalibrationValid = true;
 			usingRelPose = true;
@@ -778,23 +1057,25 @@ bool CalibrationCalc::ComputeIncremental(bool &lerp, double threshold, double re
 		lerp = m_isValid;
 		m_relativePosCalibrated = m_relativePosCalibrated || newError < 0.005;
 		if (!m_isValid) {
-			CalCtx.Log("Applying initial transformation...");
+			Log("Applying initial transformation...");
 		}
 		else if (m_relativePosCalibrated) {
-			CalCtx.Log("Applying updated transformation...");
+			Log("Applying updated transformation...");
 		} else {
-			CalCtx.Log("Applying temporary transformation...");
+			Log("Applying temporary transformation...");
 		}
 		
 		m_isValid = true;
 		m_estimatedTransformation = calibration; // @NOTE: Continuous calibration
 		m_axisVariance = newVariance;
+		// Only what was adopted sets the baseline for RefineJumpRatio; a rejected solve says nothing about it.
+		m_lastSolveError = newError;
 
 		if (!usingRelPose) {
 			m_refToTargetPose = EstimateRefToTargetPose(m_estimatedTransformation);
 		}
 
-		Metrics::calibrationApplied.Push(!usingRelPose);
+		m_report.Push(Metrics::calibrationApplied, !usingRelPose);
 
 		return true;
 	}
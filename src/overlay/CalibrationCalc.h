@@ -2,9 +2,13 @@
 
 #include <Eigen/Dense>
 #include <openvr.h>
+#include "CalibrationAccumulators.h"
+#include "CalibrationMetrics.h"
+#include "SampleBuffer.h"
+#include "SolverThreadPool.h"
 #include <vector>
-#include <deque>
 #include <iostream>
+#include <string>
 
 struct Pose
 {
@@ -59,8 +63,58 @@ class CalibrationCalc {
 public:
 	static const double AxisVarianceThreshold;
 
+	/*
+	 * Selects how the pairwise least-squares problems are solved. Streaming keeps running sums that are updated
+	 * as samples enter and leave the window, so a solve doesn't need to revisit every sample pair. AllPairs
+	 * rebuilds the full system from every pair on each solve; it is much slower, and is kept around as a
+	 * reference to diff the streaming results against.
+	 */
+	enum class SolverMode {
+		Streaming,
+		AllPairs
+	};
+
+	/*
+	 * Selects how continuous calibration updates the estimate. ClosedForm solves rotation and translation from
+	 * scratch on every update. Refine starts from the current estimate and takes a few Levenberg-Marquardt steps
+	 * on the retargeting residual, which is much cheaper while the calibration only drifts slowly; it falls back
+	 * to the closed form whenever the residual jumps.
+	 */
+	enum class ContinuousEngine {
+		ClosedForm,
+		Refine
+	};
+
+	/*
+	 * Selects which sample leaves a full window. Fifo drops the oldest one. Coreset bins the window by the
+	 * reference device's orientation and position, and drops the oldest sample of the most crowded cell: holding
+	 * still then only refreshes the one cell it sits in, rather than flushing out the spread of poses that
+	 * constrains the solve.
+	 */
+	enum class WindowPolicy {
+		Fifo,
+		Coreset
+	};
+
 	bool enableStaticRecalibration;
 	bool lockRelativePosition = false;
+	SolverMode solverMode = SolverMode::Streaming;
+	ContinuousEngine continuousEngine = ContinuousEngine::ClosedForm;
+	WindowPolicy windowPolicy = WindowPolicy::Fifo;
+	/*
+	 * With the Coreset policy, a sample landing in a cell that already holds this many replaces that cell's oldest
+	 * sample instead of growing the window; 0 for no limit. Lets a one-shot window only fill up with poses that
+	 * add something.
+	 */
+	size_t coresetCellLimit = 0;
+	// Spread the remaining O(N^2) pair loops over SolverThreadPool. Results don't depend on the thread count.
+	bool parallelSolve = true;
+	/*
+	 * Wall-clock budget for the pair loops of a solve, in seconds; 0 leaves them unbounded. Loops that run out
+	 * of time keep what they have accumulated over a stratified subset of the window, and the solve is rejected
+	 * (keeping the previous calibration) if too little of the work was covered.
+	 */
+	double solveBudget = 0.0;
 	
 	const Eigen::AffineCompact3d Transformation() const 
 	{
@@ -93,21 +147,50 @@ public:
 	}
 
 	void PushSample(const Sample& sample);
+	// Pushes a sample into a window of at most `capacity` samples, evicting one per windowPolicy when it is full.
+	// The buffer is sized to capacity + 1 on first use and never grows past that.
+	void AddSample(const Sample& sample, size_t capacity);
 	void Clear();
 
-	double ReferenceJitter() const;
-	double TargetJitter() const;
+	// Spread of each device's poses over the window, kept up to date as samples come and go.
+	const JitterAccumulator& ReferenceStats() const { return m_refJitter; }
+	const JitterAccumulator& TargetStats() const { return m_targetJitter; }
+
+	double ReferenceJitter() const { return m_refJitter.PositionJitter(); }
+	double TargetJitter() const { return m_targetJitter.PositionJitter(); }
 
 	bool ComputeOneshot(const bool ignoreOutliers);
 	bool ComputeIncremental(bool &lerp, double threshold, double relPoseMaxError, const bool ignoreOutliers);
 
+	// Fraction of the pair work the last solve got through within its budget.
+	double SolveCoverage() const { return m_budget.Coverage(); }
+
+	/*
+	 * Standard deviation of the last one-shot solve along its least constrained direction, in meters and radians,
+	 * or INFINITY if the window doesn't pin it down. Estimated from the normal equations of the retargeting
+	 * residual at the solution, scaled by the residual variance.
+	 */
+	double TranslationSigma() const { return m_translationSigma; }
+	double RotationSigma() const { return m_rotationSigma; }
+
+	// Whether the last one-shot solve is constrained well enough that more samples wouldn't improve it much.
+	bool Converged() const;
+
 	size_t SampleCount() const {
-		return m_samples.size();
+		return m_samples.Size();
 	}
 
-	void ShiftSample() {
-		if (!m_samples.empty()) m_samples.pop_front();
-	}
+	void ShiftSample();
+	void RemoveSample(size_t index);
+
+	/*
+	 * Solves may run off the main thread, so their metric pushes and log lines are recorded rather than applied.
+	 * The owner replays them on the main thread after the solve.
+	 */
+	void ReplayReport() { m_report.Replay(); }
+
+	// Takes over the calibration estimate of a copy of this window that was solved elsewhere.
+	void AdoptEstimate(const CalibrationCalc& solved);
 
 	CalibrationCalc() : m_isValid(false), m_calcCycle(0), enableStaticRecalibration(true) {}
 
@@ -127,21 +210,76 @@ private:
 	 */
 	Eigen::AffineCompact3d m_refToTargetPose = Eigen::AffineCompact3d::Identity();
 
-	std::deque<Sample> m_samples;
+	Metrics::DeferredReport m_report;
+
+	// Budget of the solve in progress. Solves are logically const, but account their progress here.
+	mutable SolveBudget m_budget;
+	void Log(const std::string& msg);
+
+	SampleBuffer m_samples;
+
+	TranslationAccumulator m_translationAccum;
+	RetargetingAccumulator m_retargetAccum;
+	JitterAccumulator m_refJitter, m_targetJitter;
+	size_t m_shiftsSinceRebuild = 0;
+
+	/*
+	 * Rotation deltas between every pair of samples in the window, and between every pair of the samples
+	 * subsampled for outlier detection. Samples are identified by their sequence number rather than their
+	 * position in the window, so the outlier subset doesn't change as samples leave it.
+	 */
+	DeltaRotationAccumulator m_rotationPairs, m_outlierPairs;
+
+	// (cell, index) of every sample, reused across evictions
+	std::vector<std::pair<uint64_t, size_t>> m_cells;
+	uint64_t CellOf(size_t index) const;
+	size_t LeastInformativeSample();
+
+	void AccumulateJitter(size_t index, bool add);
+	bool InOutlierSubset(size_t index) const;
+	void AccumulateRotationPairs(size_t index, bool add);
+	void BuildRotationPairs(DeltaRotationAccumulator* all, DeltaRotationAccumulator* outlierSubset, bool parallel, SolveBudget* budget = nullptr) const;
+	void RebuildAccumulators();
 
 	std::vector<bool> DetectOutliers() const;
 	Eigen::Vector3d CalibrateRotation(const bool ignoreOutliers) const;
 	Eigen::Vector3d CalibrateTranslation(const Eigen::Matrix3d &rotation) const;
+	Eigen::Vector3d CalibrateTranslationAllPairs(const Eigen::Matrix3d &rotation) const;
 	void CalibrateScaleOffset(const Eigen::Matrix3d &rotation, Eigen::Vector3d* out_scaleOffset, float* out_scaleFactor) const;
 
 	Eigen::AffineCompact3d ComputeCalibration(const bool ignoreOutliers) const;
+	bool RefineCalibration(Eigen::AffineCompact3d& calibration) const;
+
+	// RMS error of the last calibration solved from the window, to tell a slow drift from a jump.
+	double m_lastSolveError = INFINITY;
+
+	double m_translationSigma = INFINITY, m_rotationSigma = INFINITY;
+	void EstimateUncertainty(const Eigen::AffineCompact3d& calibration);
+
+	/*
+	 * Moments of the target positions as seen from the reference device, u = Rr^T (C * tt - tr), under a candidate
+	 * calibration C. The mean of u is the estimated reference-to-target offset p, and the RMS retargeting error
+	 * for any offset p follows from the moments as sqrt(mean(|u|^2) - 2 p . mean(u) + |p|^2), so one pass over the
+	 * window gives both.
+	 */
+	struct ResidualMoments {
+		Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+		double squaredNorm = 0;
+		size_t count = 0;
+
+		void Add(const Eigen::Vector3d& u) { sum += u; squaredNorm += u.squaredNorm(); count++; }
+
+		Eigen::Vector3d Offset() const { return sum / (double)count; }
+		double ErrorRMS(const Eigen::Vector3d& offset) const;
+	};
 
-	double RetargetingErrorRMS(const Eigen::Vector3d& hmdToTargetPos, const Eigen::AffineCompact3d& calibration) const;
-	Eigen::Vector3d ComputeRefToTargetOffset(const Eigen::AffineCompact3d& calibration) const;
+	// Evaluates the residual moments of several candidate calibrations in one sweep over the window.
+	void EvaluateResiduals(const Eigen::AffineCompact3d* calibrations, ResidualMoments* out, size_t count) const;
 
-	Eigen::Vector4d ComputeAxisVariance(const Eigen::AffineCompact3d& calibration) const;
+	Eigen::Vector4d ComputeAxisVariance() const;
 
 	[[nodiscard]] bool ValidateCalibration(const Eigen::AffineCompact3d& calibration, double *errorOut = nullptr, Eigen::Vector3d* posOffsetV = nullptr);
+	[[nodiscard]] bool ValidateCalibration(const ResidualMoments& residuals, double *errorOut = nullptr, Eigen::Vector3d* posOffsetV = nullptr);
 	void ComputeInstantOffset();
 
 	Eigen::AffineCompact3d EstimateRefToTargetPose(const Eigen::AffineCompact3d& calibration) const;
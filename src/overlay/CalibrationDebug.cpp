@@ -221,6 +221,46 @@ namespace {
 		}
 	}
 
+	void G_SolveCoverage() {
+		if (ImPlot::BeginPlot("##Solve Coverage", ImVec2(-1, 0), ImPlotFlags_NoLegend)) {
+			ImPlot::SetupAxes(nullptr, "", 0, 0);
+			SetupXAxis();
+			ImPlot::SetupAxisLimits(ImAxis_Y1, 0, 1.05, ImGuiCond_Appearing);
+
+			AddApplyTicks();
+
+			PlotLineG("Coverage", Metrics::solveCoverage);
+			ImPlot::EndPlot();
+		}
+	}
+
+	void G_FilterUncertainty() {
+		if (ImPlot::BeginPlot("##Filter Uncertainty")) {
+			ImPlot::SetupAxes(nullptr, "mm / deg", 0, ImPlotAxisFlags_AutoFit | ImPlotAxisFlags_RangeFit);
+			SetupXAxis();
+			ImPlot::SetupAxisLimits(ImAxis_Y1, 0, 10, ImGuiCond_Appearing);
+
+			AddApplyTicks();
+
+			PlotLineG("Translation", Metrics::filterSigmaTrans);
+			PlotLineG("Rotation", Metrics::filterSigmaRot);
+			ImPlot::EndPlot();
+		}
+	}
+
+	void G_Latency() {
+		if (ImPlot::BeginPlot("##Latency", ImVec2(-1, 0), ImPlotFlags_NoLegend)) {
+			ImPlot::SetupAxes(nullptr, "ms", 0, ImPlotAxisFlags_AutoFit | ImPlotAxisFlags_RangeFit);
+			SetupXAxis();
+			ImPlot::SetupAxisLimits(ImAxis_Y1, -50, 50, ImGuiCond_Appearing);
+
+			AddApplyTicks();
+
+			PlotLineG("Latency", Metrics::latency);
+			ImPlot::EndPlot();
+		}
+	}
+
 	void G_JitterReference() {
 		if (ImPlot::BeginPlot("##JitterReference", ImVec2(-1, 0), ImPlotFlags_NoLegend)) {
 			ImPlot::SetupAxes(nullptr, "", 0, ImPlotAxisFlags_AutoFit | ImPlotAxisFlags_RangeFit);
@@ -321,6 +361,9 @@ namespace {
 		{ "Offset: Last Sample", G_PosOffset_LastSample },
 		{ "Offset: By Rel Pose", G_PosOffset_ByRelPose },
 		{ "Processing time", G_ComputationTime },
+		{ "Solve coverage", G_SolveCoverage },
+		{ "Filter uncertainty", G_FilterUncertainty },
+		{ "Latency", G_Latency },
 		{ "Reference Jitter", G_JitterReference },
 		{ "Target Jitter", G_JitterTarget }
 	};
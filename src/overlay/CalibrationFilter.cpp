@@ -0,0 +1,156 @@
+#include "CalibrationFilter.h"
+
+#include <algorithm>
+
+// Standard deviations of a single pose pair's rotation (radians) and position (meters) residual. These cover
+// tracking noise as well as the skew between the two devices' pose timestamps while moving.
+static const double MeasurementRotationSigma = 0.035;
+static const double MeasurementTranslationSigma = 0.01;
+
+// Random walk of the calibration (playspace drift) and of the offset (a tracker slipping on its mount), per sqrt(s).
+static const double CalibrationRotationDrift = 0.002;
+static const double CalibrationTranslationDrift = 0.002;
+static const double OffsetRotationDrift = 0.001;
+static const double OffsetTranslationDrift = 0.0005;
+
+// Uncertainty of a freshly seeded state.
+static const double InitialRotationSigma = 0.01;
+static const double InitialTranslationSigma = 0.005;
+static const double InitialOffsetRotationSigma = 0.02;
+
+// Pairs with a normalized innovation squared beyond this are rejected (chi-squared, 6 DoF, p = 0.001).
+static const double InnovationGate = 22.46;
+
+// How long pairs may keep getting rejected, in seconds, before the filter is considered lost.
+static const double MaxRejectedSpan = 2.0;
+
+// Longest step the process model is extrapolated over; a larger gap means the devices weren't tracking.
+static const double MaxPredictStep = 0.5;
+
+namespace {
+	typedef Eigen::Matrix<double, 6, 10> Matrix6x10d;
+	typedef Eigen::Matrix<double, 10, 6> Matrix10x6d;
+	typedef Eigen::Matrix<double, 6, 6> Matrix6d;
+	typedef Eigen::Matrix<double, 6, 1> Vector6d;
+	typedef Eigen::Matrix<double, 10, 1> Vector10d;
+
+	Eigen::Matrix3d Skew(const Eigen::Vector3d& v) {
+		Eigen::Matrix3d m;
+		m << 0, -v.z(), v.y(),
+			v.z(), 0, -v.x(),
+			-v.y(), v.x(), 0;
+		return m;
+	}
+
+	Eigen::Matrix3d ExpRotation(const Eigen::Vector3d& v) {
+		const double angle = v.norm();
+		if (angle == 0) return Eigen::Matrix3d::Identity();
+		return Eigen::AngleAxisd(angle, v / angle).toRotationMatrix();
+	}
+
+	// The rotation about y closest to a (nearly level) rotation
+	Eigen::Matrix3d YawRotation(const Eigen::Matrix3d& rotation) {
+		return Eigen::AngleAxisd(atan2(rotation(0, 2), rotation(2, 2)), Eigen::Vector3d::UnitY()).toRotationMatrix();
+	}
+
+	Eigen::Vector3d LogRotation(const Eigen::Matrix3d& rotation) {
+		const Eigen::AngleAxisd angleAxis(rotation);
+		return angleAxis.angle() * angleAxis.axis();
+	}
+}
+
+void CalibrationFilter::Reset(const Eigen::AffineCompact3d& calibration, const Eigen::AffineCompact3d& refToTarget) {
+	m_calibration = calibration;
+	m_calibration.linear() = YawRotation(calibration.linear());
+	m_refToTarget = refToTarget;
+
+	Vector10d variance;
+	variance <<
+		InitialRotationSigma * InitialRotationSigma,
+		Eigen::Vector3d::Constant(InitialTranslationSigma * InitialTranslationSigma),
+		Eigen::Vector3d::Constant(InitialOffsetRotationSigma * InitialOffsetRotationSigma),
+		Eigen::Vector3d::Constant(InitialTranslationSigma * InitialTranslationSigma);
+	m_covariance = variance.asDiagonal();
+
+	m_initialized = true;
+	m_time = -1.0;
+	m_rejectedRun = 0;
+}
+
+bool CalibrationFilter::Diverged() const {
+	return m_initialized && m_rejectedRun > 0 && m_time - m_rejectedSince > MaxRejectedSpan;
+}
+
+void CalibrationFilter::Predict(double time) {
+	if (m_time >= 0) {
+		const double dt = std::min(std::max(time - m_time, 0.0), MaxPredictStep);
+
+		Vector10d drift;
+		drift <<
+			CalibrationRotationDrift * CalibrationRotationDrift,
+			Eigen::Vector3d::Constant(CalibrationTranslationDrift * CalibrationTranslationDrift),
+			Eigen::Vector3d::Constant(OffsetRotationDrift * OffsetRotationDrift),
+			Eigen::Vector3d::Constant(OffsetTranslationDrift * OffsetTranslationDrift);
+		m_covariance.diagonal() += drift * dt;
+	}
+
+	m_time = std::max(time, m_time);
+}
+
+bool CalibrationFilter::Update(const Pose& ref, const Pose& target, double time) {
+	if (!m_initialized) return false;
+
+	Predict(time);
+
+	const Eigen::Matrix3d calibrationRot = m_calibration.linear();
+	const Eigen::Matrix3d offsetRot = m_refToTarget.linear();
+	const Eigen::Matrix3d refOffsetRot = ref.rot * offsetRot;
+	const Eigen::Vector3d rotatedTarget = calibrationRot * target.trans;
+
+	// Residuals of the rigid attachment under the current estimate; both are zero at the truth.
+	Vector6d innovation;
+	innovation.head<3>() = -LogRotation(calibrationRot * target.rot * refOffsetRot.transpose());
+	innovation.tail<3>() = -(rotatedTarget + m_calibration.translation() - ref.trans - ref.rot * m_refToTarget.translation());
+
+	// The calibration's yaw turns it about y, in world space
+	Matrix6x10d H = Matrix6x10d::Zero();
+	H.block<3, 1>(0, 0) = Eigen::Vector3d::UnitY();
+	H.block<3, 3>(0, 4) = -refOffsetRot;
+	H.block<3, 1>(3, 0) = -Skew(rotatedTarget).col(1);
+	H.block<3, 3>(3, 1).setIdentity();
+	H.block<3, 3>(3, 7) = -ref.rot;
+
+	Vector6d noise;
+	noise <<
+		Eigen::Vector3d::Constant(MeasurementRotationSigma * MeasurementRotationSigma),
+		Eigen::Vector3d::Constant(MeasurementTranslationSigma * MeasurementTranslationSigma);
+
+	const Matrix10x6d PHt = m_covariance * H.transpose();
+	Matrix6d S = H * PHt;
+	S.diagonal() += noise;
+
+	const Eigen::LDLT<Matrix6d> solver(S);
+	if (solver.info() != Eigen::Success) return false;
+
+	if (innovation.dot(solver.solve(innovation)) > InnovationGate) {
+		if (m_rejectedRun++ == 0) m_rejectedSince = m_time;
+		return false;
+	}
+	m_rejectedRun = 0;
+
+	// K = P H^T S^-1, using that S is symmetric
+	const Matrix10x6d K = solver.solve(PHt.transpose()).transpose();
+	const Vector10d dx = K * innovation;
+	if (!dx.allFinite()) return false;
+
+	m_covariance -= K * PHt.transpose();
+	m_covariance = (0.5 * (m_covariance + m_covariance.transpose())).eval();
+
+	// Fold the error state back into the estimate
+	m_calibration.linear() = Eigen::AngleAxisd(dx(0), Eigen::Vector3d::UnitY()).toRotationMatrix() * calibrationRot;
+	m_calibration.translation() += dx.segment<3>(1);
+	m_refToTarget.linear() = offsetRot * ExpRotation(dx.segment<3>(4));
+	m_refToTarget.translation() += dx.segment<3>(7);
+
+	return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include "CalibrationCalc.h"
+
+/*
+ * Error-state Kalman filter over the calibration and the reference-to-target offset, used as a recursive
+ * alternative to re-solving the sample window in continuous calibration.
+ *
+ * The state is the calibration C = (Rc, tc), which maps target space into reference space, and the pose
+ * X = (Q, p) of the target in the reference device's local space. Every reference/target pose pair measures
+ * that the two devices are rigidly attached, i.e. Rc * Rt = Rr * Q and Rc * tt + tc = Rr * p + tr. Like the
+ * batch solves, the calibration only turns about the vertical axis, so Rc is a yaw. The filter tracks a
+ * 10-dimensional error state around its estimate (the yaw of C, and rotations perturbed on the right for X, as in
+ * RetargetingAccumulator), so each update is a fixed-size 6x10 linearization and costs the same however long
+ * calibration has been running. Both halves of the state are modelled as slow random walks, which
+ * lets it follow drifting playspaces.
+ *
+ * The linearization only holds near the truth, so the filter is seeded from a solved calibration rather than
+ * started cold. Pairs whose innovation is implausible under the current covariance are rejected; a long run of
+ * them means the playspaces jumped, and the owner should fall back to a batch solve and reseed.
+ */
+class CalibrationFilter {
+public:
+	typedef Eigen::Matrix<double, 10, 10> Matrix10d;
+
+	// Seeds the filter with a solved calibration and reference-to-target pose. Any tilt of the calibration is dropped.
+	void Reset(const Eigen::AffineCompact3d& calibration, const Eigen::AffineCompact3d& refToTarget);
+	void Clear() { m_initialized = false; }
+
+	bool Initialized() const { return m_initialized; }
+
+	/*
+	 * Predicts the state forward to `time` (in seconds, on any clock that the caller uses consistently) and
+	 * folds in one reference/target pose pair. Returns false if the pair was rejected as an outlier.
+	 */
+	bool Update(const Pose& ref, const Pose& target, double time);
+
+	// True once enough consecutive pairs were rejected that the estimate can no longer be trusted.
+	bool Diverged() const;
+
+	const Eigen::AffineCompact3d& Transformation() const { return m_calibration; }
+	const Eigen::AffineCompact3d& RelativeTransformation() const { return m_refToTarget; }
+
+	/*
+	 * Covariance of the error state, ordered as calibration yaw, calibration translation, offset rotation and
+	 * offset translation; rotations are in radians and translations in meters.
+	 */
+	const Matrix10d& Covariance() const { return m_covariance; }
+
+	// RMS standard deviation of the calibration's translation (meters), and that of its yaw (radians).
+	double TranslationSigma() const { return sqrt(m_covariance.block<3, 3>(1, 1).trace() / 3.0); }
+	double RotationSigma() const { return sqrt(m_covariance(0, 0)); }
+
+private:
+	void Predict(double time);
+
+	bool m_initialized = false;
+	double m_time = -1.0;
+	size_t m_rejectedRun = 0;
+	double m_rejectedSince = 0.0;
+
+	Eigen::AffineCompact3d m_calibration = Eigen::AffineCompact3d::Identity();
+	Eigen::AffineCompact3d m_refToTarget = Eigen::AffineCompact3d::Identity();
+	Matrix10d m_covariance = Matrix10d::Identity();
+};
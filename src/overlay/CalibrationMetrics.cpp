@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "CalibrationMetrics.h"
+#include "RotationDeltaKernel.h"
 #include <shlobj_core.h>
 #include <fstream>
 #include <vector>
@@ -15,7 +16,10 @@ namespace Metrics {
 	TimeSeries<double> error_rawComputed, error_currentCal, error_byRelPose, error_currentCalRelPose;
 	TimeSeries<double> axisIndependence;
 	TimeSeries<double> computationTime;
+	TimeSeries<double> solveCoverage;
 	TimeSeries<double> jitterRef, jitterTarget;
+	TimeSeries<double> filterSigmaTrans, filterSigmaRot;
+	TimeSeries<double> latency;
 
 	// true - full calibration, false - static calibration
 	TimeSeries<bool> calibrationApplied;
@@ -113,8 +117,12 @@ namespace Metrics {
 		TS_FIELD(error_currentCalRelPose),
 		TS_FIELD(axisIndependence),
 		TS_FIELD(computationTime),
+		TS_FIELD(solveCoverage),
 		TS_FIELD(jitterRef),
 		TS_FIELD(jitterTarget),
+		TS_FIELD(filterSigmaTrans),
+		TS_FIELD(filterSigmaRot),
+		TS_FIELD(latency),
 
 		{
 			"calibrationApplied", 
@@ -211,6 +219,7 @@ namespace Metrics {
 			logFile << fields[i].name;
 		}
 		logFile << "\n";
+		logFile << "# Rotation delta kernel: " << RotationDeltaKernelName() << "\n";
 
 		logFileIsOpen = true;
 
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <deque>
+#include <functional>
 #include <utility>
+#include <vector>
 #include <Eigen/Dense>
 
 namespace Metrics {
@@ -48,10 +50,39 @@ namespace Metrics {
 	extern TimeSeries<double> error_rawComputed, error_currentCal, error_byRelPose, error_currentCalRelPose;
 	extern TimeSeries<double> axisIndependence;
 	extern TimeSeries<double> computationTime;
+	extern TimeSeries<double> solveCoverage; // share of the pair work a budgeted solve got through, per its slowest loop
 	extern TimeSeries<double> jitterRef, jitterTarget;
+	extern TimeSeries<double> filterSigmaTrans, filterSigmaRot; // standard deviation of the filtered calibration, mm and degrees
+	extern TimeSeries<double> latency; // ms by which the target lags the reference
 
 	extern TimeSeries<bool> calibrationApplied;
 
+	/*
+	 * Metric pushes (and any other main-thread-only side effects, like logging to CalCtx) recorded by the
+	 * background solver. Neither TimeSeries nor CalibrationContext are thread-safe, so they are replayed on the
+	 * main thread once the solve result is handed back.
+	 */
+	class DeferredReport {
+		std::vector<std::function<void()>> Entries;
+
+	public:
+		template<typename T, typename U>
+		void Push(TimeSeries<T>& series, const U& data) {
+			Entries.push_back([&series, value = T(data)]() { series.Push(value); });
+		}
+
+		void Defer(std::function<void()> fn) {
+			Entries.push_back(std::move(fn));
+		}
+
+		void Replay() {
+			for (auto& entry : Entries) entry();
+			Entries.clear();
+		}
+
+		void Clear() { Entries.clear(); }
+	};
+
 	extern bool enableLogs;
 
 	void WriteLogAnnotation(const char* s);
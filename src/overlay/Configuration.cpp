@@ -133,7 +133,15 @@ static void ParseProfile(CalibrationContext &ctx, std::istream &stream)
 	}
 	ctx.quashTargetInContinuous = obj["quash_target_in_continuous"].evaluate_as_boolean();
 	ctx.requireTriggerPressToApply = obj["require_trigger_press_to_apply"].evaluate_as_boolean();
-	ctx.ignoreOutliers = obj["ignore_outliers"].evaluate_as_boolean();
+	if (obj["ignore_outliers"].is<bool>()) {
+		ctx.ignoreOutliers = obj["ignore_outliers"].get<bool>();
+	}
+	if (obj["parallel_solver"].is<bool>()) {
+		ctx.parallelSolver = obj["parallel_solver"].get<bool>();
+	}
+	if (obj["coreset_window"].is<bool>()) {
+		ctx.coresetWindow = obj["coreset_window"].get<bool>();
+	}
 	ctx.continuousCalibrationOffset(0) = obj["continuous_calibration_target_offset_x"].get<double>();
 	ctx.continuousCalibrationOffset(1) = obj["continuous_calibration_target_offset_y"].get<double>();
 	ctx.continuousCalibrationOffset(2) = obj["continuous_calibration_target_offset_z"].get<double>();
@@ -161,6 +169,30 @@ static void ParseProfile(CalibrationContext &ctx, std::istream &stream)
 		ctx.calibrationSpeed = (CalibrationContext::Speed)(int) obj["calibration_speed"].get<double>();
 	}
 
+	if (obj["continuous_solver"].is<double>()) {
+		ctx.continuousSolver = (CalibrationContext::ContinuousSolver)(int) obj["continuous_solver"].get<double>();
+	} else {
+		ctx.continuousSolver = CalibrationContext::CLOSED_FORM;
+	}
+
+	if (obj["solve_budget_ms"].is<double>()) {
+		ctx.solveBudgetMs = (float) obj["solve_budget_ms"].get<double>();
+	} else {
+		ctx.solveBudgetMs = 0.0f;
+	}
+
+	if (obj["target_latency"].is<double>()) {
+		ctx.targetLatency = obj["target_latency"].get<double>();
+	} else {
+		ctx.targetLatency = 0.0;
+	}
+
+	if (obj["compensate_latency"].is<bool>()) {
+		ctx.compensateLatency = obj["compensate_latency"].get<bool>();
+	} else {
+		ctx.compensateLatency = false;
+	}
+
 	if (obj["chaperone"].is<picojson::object>()) {
 		auto chaperone = obj["chaperone"].get<picojson::object>();
 		ctx.chaperone.autoApply = chaperone["auto_apply"].get<bool>();
@@ -255,6 +287,8 @@ static void WriteProfile(CalibrationContext &ctx, std::ostream &out)
 	profile["quash_target_in_continuous"].set<bool>(ctx.quashTargetInContinuous);
 	profile["require_trigger_press_to_apply"].set<bool>(ctx.requireTriggerPressToApply);
 	profile["ignore_outliers"].set<bool>(ctx.ignoreOutliers);
+	profile["parallel_solver"].set<bool>(ctx.parallelSolver);
+	profile["coreset_window"].set<bool>(ctx.coresetWindow);
 	profile["continuous_calibration_target_offset_x"].set<double>(ctx.continuousCalibrationOffset(0));
 	profile["continuous_calibration_target_offset_y"].set<double>(ctx.continuousCalibrationOffset(1));
 	profile["continuous_calibration_target_offset_z"].set<double>(ctx.continuousCalibrationOffset(2));
@@ -267,6 +301,15 @@ static void WriteProfile(CalibrationContext &ctx, std::ostream &out)
 	double speed = (int) ctx.calibrationSpeed;
 	profile["calibration_speed"].set<double>(speed);
 
+	double continuousSolver = (int) ctx.continuousSolver;
+	profile["continuous_solver"].set<double>(continuousSolver);
+
+	double solveBudgetMs = (double)ctx.solveBudgetMs;
+	profile["solve_budget_ms"].set<double>(solveBudgetMs);
+
+	profile["target_latency"].set<double>(ctx.targetLatency);
+	profile["compensate_latency"].set<bool>(ctx.compensateLatency);
+
 	if (ctx.chaperone.valid) {
 		picojson::object chaperone;
 		chaperone["auto_apply"].set<bool>(ctx.chaperone.autoApply);
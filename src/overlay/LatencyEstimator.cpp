@@ -0,0 +1,213 @@
+#include "LatencyEstimator.h"
+
+#include <algorithm>
+
+// The signals are resampled at 500 Hz and correlated over the last ~4 seconds.
+static const double GridStep = 0.002;
+static const size_t WindowSize = 2048;
+static const size_t SpectrumSize = WindowSize * 2; // zero-padded, so the correlation doesn't wrap around
+
+// Each signal keeps a little more than the window, as one may run ahead of the other.
+static const size_t HistorySize = WindowSize * 2;
+
+// Lags searched, in either direction, in seconds.
+static const double MaxLatency = 0.2;
+
+// Poses further apart than this, in seconds, break the signal.
+static const double MaxPoseGap = 0.1;
+
+// Angular speeds are taken over at least this many seconds, as differencing poses that are only a millisecond
+// apart mostly measures tracking noise.
+static const double MinSpeedBaseline = 0.01;
+
+// Minimum variance of both angular speed signals, in (rad/s)^2; holding still says nothing about the lag.
+static const double MinSpeedVariance = 0.05;
+
+// Minimum normalized correlation at the peak for it to count.
+static const double MinConfidence = 0.6;
+
+// Weight of each new measurement in the running estimate.
+static const double LatencySmoothing = 0.3;
+
+namespace {
+	typedef std::complex<double> Complex;
+
+	// In-place iterative radix-2 FFT; data.size() must be a power of two. The inverse is left unscaled.
+	void FFT(std::vector<Complex>& data, bool inverse) {
+		const size_t n = data.size();
+
+		for (size_t i = 1, j = 0; i < n; i++) {
+			size_t bit = n >> 1;
+			for (; j & bit; bit >>= 1) j ^= bit;
+			j ^= bit;
+			if (i < j) std::swap(data[i], data[j]);
+		}
+
+		for (size_t length = 2; length <= n; length <<= 1) {
+			const double angle = 2 * EIGEN_PI / (double)length * (inverse ? 1 : -1);
+			const Complex step(cos(angle), sin(angle));
+
+			for (size_t start = 0; start < n; start += length) {
+				Complex twiddle(1.0, 0.0);
+				for (size_t k = 0; k < length / 2; k++) {
+					const Complex even = data[start + k];
+					const Complex odd = data[start + k + length / 2] * twiddle;
+					data[start + k] = even + odd;
+					data[start + k + length / 2] = even - odd;
+					twiddle *= step;
+				}
+			}
+		}
+	}
+}
+
+LatencyEstimator::LatencyEstimator() {
+	Clear();
+}
+
+void LatencyEstimator::Clear() {
+	m_reference.Clear();
+	m_target.Clear();
+	m_valid = false;
+	m_latency = 0.0;
+	m_confidence = 0.0;
+}
+
+void LatencyEstimator::Channel::Clear() {
+	m_speed.assign(HistorySize, 0.0);
+	m_first = 0;
+	m_last = -1;
+	m_havePose = false;
+	m_haveSpeed = false;
+}
+
+double LatencyEstimator::Channel::At(int64_t index) const {
+	return m_speed[(size_t)(index % (int64_t)HistorySize)];
+}
+
+void LatencyEstimator::Channel::Put(int64_t index, double speed) {
+	if (index != m_last + 1) m_first = index;
+	m_speed[(size_t)(index % (int64_t)HistorySize)] = speed;
+	m_last = index;
+}
+
+void LatencyEstimator::Channel::Add(double time, const Eigen::Matrix3d& rotation, bool valid) {
+	if (!valid) {
+		m_havePose = false;
+		m_haveSpeed = false;
+		return;
+	}
+
+	const Eigen::Quaterniond quat(rotation);
+
+	if (m_havePose && time - m_poseTime < MinSpeedBaseline) return;
+
+	if (m_havePose) {
+		const double dt = time - m_poseTime;
+
+		if (dt > MaxPoseGap) {
+			m_haveSpeed = false;
+		} else {
+			// The finite difference gives the speed halfway between the two poses; fill in the grid points since
+			// the previous one by linear interpolation.
+			const double speed = quat.angularDistance(m_poseRotation) / dt;
+			const double speedTime = m_poseTime + dt / 2;
+
+			if (m_haveSpeed) {
+				const int64_t end = (int64_t)floor(speedTime / GridStep);
+				for (int64_t index = std::max((int64_t)floor(m_speedTime / GridStep) + 1, m_last + 1); index <= end; index++) {
+					const double s = (index * GridStep - m_speedTime) / (speedTime - m_speedTime);
+					Put(index, m_lastSpeed + s * (speed - m_lastSpeed));
+				}
+			}
+
+			m_speedTime = speedTime;
+			m_lastSpeed = speed;
+			m_haveSpeed = true;
+		}
+	}
+
+	m_poseTime = time;
+	m_poseRotation = quat;
+	m_havePose = true;
+}
+
+bool LatencyEstimator::Update() {
+	// Latest window that both signals cover without interruption
+	const int64_t last = std::min(m_reference.Last(), m_target.Last());
+	const int64_t first = last - (int64_t)WindowSize + 1;
+	if (first < 0 || m_reference.First() > first || m_target.First() > first) return false;
+	if (std::max(m_reference.Last(), m_target.Last()) - first >= (int64_t)HistorySize) return false;
+
+	/*
+	 * Only the middle of the target window is correlated against the whole reference window, so that every lag
+	 * searched overlaps the same number of samples; otherwise the shrinking overlap would pull the peak towards
+	 * zero.
+	 */
+	const int64_t maxLag = (int64_t)(MaxLatency / GridStep);
+	const size_t segmentBegin = (size_t)maxLag, segmentEnd = WindowSize - (size_t)maxLag;
+
+	m_referenceSpectrum.assign(SpectrumSize, Complex());
+	m_targetSpectrum.assign(SpectrumSize, Complex());
+	m_referenceSquares.resize(WindowSize + 1);
+
+	double referenceMean = 0, targetMean = 0;
+	for (size_t i = 0; i < WindowSize; i++) {
+		referenceMean += m_reference.At(first + i);
+	}
+	for (size_t i = segmentBegin; i < segmentEnd; i++) {
+		targetMean += m_target.At(first + i);
+	}
+	referenceMean /= WindowSize;
+	targetMean /= segmentEnd - segmentBegin;
+
+	m_referenceSquares[0] = 0;
+	for (size_t i = 0; i < WindowSize; i++) {
+		const double reference = m_reference.At(first + i) - referenceMean;
+		m_referenceSpectrum[i] = reference;
+		m_referenceSquares[i + 1] = m_referenceSquares[i] + reference * reference;
+	}
+
+	double targetEnergy = 0;
+	for (size_t i = segmentBegin; i < segmentEnd; i++) {
+		const double target = m_target.At(first + i) - targetMean;
+		m_targetSpectrum[i] = target;
+		targetEnergy += target * target;
+	}
+
+	const double minEnergy = MinSpeedVariance * (segmentEnd - segmentBegin);
+	if (m_referenceSquares[WindowSize] < minEnergy || targetEnergy < minEnergy) return false;
+
+	// corr[k] = sum(reference[i] * target[i + k]), which peaks at the lag k of the target
+	FFT(m_referenceSpectrum, false);
+	FFT(m_targetSpectrum, false);
+	for (size_t i = 0; i < SpectrumSize; i++) {
+		m_targetSpectrum[i] *= std::conj(m_referenceSpectrum[i]);
+	}
+	FFT(m_targetSpectrum, true);
+
+	// Normalized by the energy of the reference samples that the target segment lines up with at each lag
+	const auto correlation = [&](int64_t lag) {
+		const double referenceEnergy = m_referenceSquares[segmentEnd - lag] - m_referenceSquares[segmentBegin - lag];
+		const double product = m_targetSpectrum[(size_t)((lag + (int64_t)SpectrumSize) % (int64_t)SpectrumSize)].real() / SpectrumSize;
+		return referenceEnergy > 0 ? product / sqrt(referenceEnergy * targetEnergy) : 0.0;
+	};
+
+	int64_t peak = -maxLag;
+	for (int64_t lag = -maxLag + 1; lag <= maxLag; lag++) {
+		if (correlation(lag) > correlation(peak)) peak = lag;
+	}
+
+	m_confidence = correlation(peak);
+	if (m_confidence < MinConfidence || peak == -maxLag || peak == maxLag) return false;
+
+	// Refine the peak to below the grid step with a parabola through its neighbours
+	const double before = correlation(peak - 1), at = correlation(peak), after = correlation(peak + 1);
+	const double curvature = before - 2 * at + after;
+	const double offset = curvature < 0 ? 0.5 * (before - after) / curvature : 0.0;
+	const double latency = (peak + offset) * GridStep;
+
+	m_latency = m_valid ? m_latency + LatencySmoothing * (latency - m_latency) : latency;
+	m_valid = true;
+	return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Measures how much later the target device's poses describe a motion than the reference device's do.
+ *
+ * Tracking systems report poses with different latencies, which skews every pose pair taken while the devices
+ * move. Since the devices are rigidly attached they share the same angular speed at every instant, whatever
+ * their orientation or the calibration, so the lag is the shift that best lines up the two devices' angular
+ * speed signals. Both signals are resampled onto a common uniform grid, and their cross-correlation over the
+ * last few seconds is evaluated for every shift at once with FFTs.
+ */
+class LatencyEstimator {
+public:
+	LatencyEstimator();
+
+	void Clear();
+
+	// Feeds a pose of either device, at `time` seconds. Invalid poses break the signal.
+	void AddReference(double time, const Eigen::Matrix3d& rotation, bool valid) { m_reference.Add(time, rotation, valid); }
+	void AddTarget(double time, const Eigen::Matrix3d& rotation, bool valid) { m_target.Add(time, rotation, valid); }
+
+	/*
+	 * Correlates the latest window of both signals. If there was enough motion and a clear peak, folds the lag
+	 * into the estimate and returns true.
+	 */
+	bool Update();
+
+	bool Valid() const { return m_valid; }
+
+	// Seconds by which the target lags the reference; negative if the reference lags.
+	double Latency() const { return m_latency; }
+
+	// Normalized correlation at the peak of the last update that had enough motion, in [-1, 1].
+	double Confidence() const { return m_confidence; }
+
+private:
+	// Angular speed of one device, resampled onto the grid times k * GridStep.
+	class Channel {
+	public:
+		void Clear();
+		void Add(double time, const Eigen::Matrix3d& rotation, bool valid);
+
+		// Grid index of the latest sample, and the first one of the uninterrupted run leading up to it.
+		int64_t Last() const { return m_last; }
+		int64_t First() const { return m_first; }
+
+		double At(int64_t index) const;
+
+	private:
+		void Put(int64_t index, double speed);
+
+		std::vector<double> m_speed;
+		int64_t m_first = 0, m_last = -1;
+
+		bool m_havePose = false, m_haveSpeed = false;
+		double m_poseTime = 0.0;
+		Eigen::Quaterniond m_poseRotation;
+		double m_speedTime = 0.0, m_lastSpeed = 0.0;
+	};
+
+	Channel m_reference, m_target;
+
+	bool m_valid = false;
+	double m_latency = 0.0;
+	double m_confidence = 0.0;
+
+	std::vector<std::complex<double>> m_referenceSpectrum, m_targetSpectrum;
+	std::vector<double> m_referenceSquares; // prefix sums of the squared reference window
+};
@@ -0,0 +1,62 @@
+#include "PoseHistory.h"
+
+// Longest gap between two poses that is still interpolated across, in seconds.
+static const double MaxInterpolationGap = 0.1;
+
+bool PoseHistory::Push(const TimedPose& pose) {
+	if (m_size > 0 && pose.time <= Latest().time) return false;
+
+	if (m_size == m_entries.size()) {
+		m_entries[m_head] = pose;
+		m_head = Slot(1);
+	} else {
+		m_entries[Slot(m_size++)] = pose;
+	}
+	return true;
+}
+
+size_t PoseHistory::Find(double time) const {
+	if (m_size == 0 || At(0).time > time) return npos;
+
+	// Invariant: At(low).time <= time < At(high).time, with high == m_size standing in for +infinity
+	size_t low = 0, high = m_size;
+	while (high - low > 1) {
+		const size_t mid = low + (high - low) / 2;
+		if (At(mid).time <= time) low = mid;
+		else high = mid;
+	}
+	return low;
+}
+
+bool PoseHistory::Interpolate(double time, Pose& out) const {
+	const size_t index = Find(time);
+	if (index == npos) return false;
+
+	const TimedPose& a = At(index);
+	if (a.time == time) {
+		out = a.pose;
+		return a.valid;
+	}
+	if (index + 1 >= m_size) return false;
+
+	const TimedPose& b = At(index + 1);
+	const double gap = b.time - a.time;
+	if (!a.valid || !b.valid || gap > MaxInterpolationGap) return false;
+
+	const double s = (time - a.time) / gap;
+
+	out.rot = Eigen::Quaterniond(a.pose.rot).slerp(s, Eigen::Quaterniond(b.pose.rot)).toRotationMatrix();
+
+	if (a.velocity.squaredNorm() > 0 && b.velocity.squaredNorm() > 0) {
+		const double s2 = s * s, s3 = s2 * s;
+		out.trans =
+			(2 * s3 - 3 * s2 + 1) * a.pose.trans +
+			(s3 - 2 * s2 + s) * gap * a.velocity +
+			(-2 * s3 + 3 * s2) * b.pose.trans +
+			(s3 - s2) * gap * b.velocity;
+	} else {
+		out.trans = a.pose.trans + s * (b.pose.trans - a.pose.trans);
+	}
+
+	return true;
+}
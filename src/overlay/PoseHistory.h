@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <vector>
+#include "CalibrationCalc.h"
+
+struct TimedPose {
+	Pose pose;
+	// World-space linear velocity in m/s, if the driver reports one; zero otherwise.
+	Eigen::Vector3d velocity = Eigen::Vector3d::Zero();
+	// Time the pose was sampled at, in seconds, with the driver's poseTimeOffset already applied.
+	double time = 0.0;
+	bool valid = false;
+};
+
+/*
+ * The last second or so of one device's poses, as a ring ordered by time, so the pose at any recent instant can
+ * be looked up by binary search and interpolated from the two poses around it.
+ */
+class PoseHistory {
+public:
+	static const size_t DefaultCapacity = 1024;
+
+	explicit PoseHistory(size_t capacity = DefaultCapacity) : m_entries(capacity) { }
+
+	// Appends a pose, overwriting the oldest once full. Poses that don't come after the latest one are dropped.
+	bool Push(const TimedPose& pose);
+	void Clear() { m_head = 0; m_size = 0; }
+
+	size_t Size() const { return m_size; }
+	bool Empty() const { return m_size == 0; }
+
+	// Index 0 is the oldest pose.
+	const TimedPose& At(size_t index) const { return m_entries[Slot(index)]; }
+	const TimedPose& Latest() const { return At(m_size - 1); }
+
+	// Index of the latest pose at or before `time`, or npos if all of them are later.
+	size_t Find(double time) const;
+	static const size_t npos = (size_t)-1;
+
+	/*
+	 * The pose at `time`, interpolated between the two poses around it: slerp for the rotation, and a cubic
+	 * Hermite spline through both ends' velocities for the position when the driver reports velocities, or lerp
+	 * otherwise. Fails if `time` isn't covered by the history, or either pose is invalid or too far apart.
+	 */
+	bool Interpolate(double time, Pose& out) const;
+
+private:
+	size_t Slot(size_t index) const {
+		const size_t slot = m_head + index;
+		return slot < m_entries.size() ? slot : slot - m_entries.size();
+	}
+
+	std::vector<TimedPose> m_entries;
+	size_t m_head = 0;
+	size_t m_size = 0;
+};
@@ -0,0 +1,254 @@
+#include "RotationDeltaKernel.h"
+
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define ROTATION_DELTA_AVX2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define ROTATION_DELTA_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+	/*
+	 * A pair is usable when the devices rotated at least 0.4 rad between the two samples. For a relative rotation
+	 * quaternion (w, v) the half-angle is atan2(|v|, |w|), so this is |v| > tan(0.2) * |w|, which we compare
+	 * squared to keep transcendentals out of the loop.
+	 */
+	const double TanSqHalfMinAngle = std::tan(0.2) * std::tan(0.2);
+
+	// The rotation matrix of a pair gives an axis of length 2 * sin(angle) = 4 * |v| * |w|, which must exceed
+	// 0.01 for the axis direction to be trusted. Again compared squared.
+	const double MinAxisNormSq = 0.01 * 0.01;
+
+	/*
+	 * Axis of pivot * conj(q) for one device. The relative rotation's vector part is sin(angle / 2) * axis; we flip
+	 * it when w < 0 so that the angle lies in [0, pi] like it would for a rotation matrix, and then normalize.
+	 * Returns whether the pair is usable.
+	 *
+	 * Each component of the vector part is summed as (a - b) + (c - d), so swapping pivot and q negates it exactly
+	 * and leaves w as is. A pair therefore comes out bit for bit the same (and is usable or not alike) whichever
+	 * of its samples is the pivot, given the matching axisSign; the running pair sums rely on that to remove
+	 * exactly what they added.
+	 */
+	inline bool DeltaAxisScalar(
+		const double (&p)[4], double qw, double qx, double qy, double qz, double axisSign,
+		double& outX, double& outY, double& outZ
+	) {
+		const double dw = p[0] * qw + p[1] * qx + p[2] * qy + p[3] * qz;
+		const double dx = (p[1] * qw - p[0] * qx) + (p[3] * qy - p[2] * qz);
+		const double dy = (p[2] * qw - p[0] * qy) + (p[1] * qz - p[3] * qx);
+		const double dz = (p[3] * qw - p[0] * qz) + (p[2] * qx - p[1] * qy);
+
+		const double vv = dx * dx + dy * dy + dz * dz;
+		const double ww = dw * dw;
+
+		const double inv = (dw < 0 ? -axisSign : axisSign) / std::sqrt(vv);
+		outX = dx * inv;
+		outY = dy * inv;
+		outZ = dz * inv;
+
+		return vv > TanSqHalfMinAngle * ww && 16.0 * vv * ww > MinAxisNormSq;
+	}
+
+	void ComputeRotationDeltasScalar(
+		const double (&pivotRef)[4], const double (&pivotTarget)[4],
+		const QuaternionLanes& ref, const QuaternionLanes& target,
+		size_t begin, size_t count, double axisSign, RotationDeltaBatch& out
+	) {
+		for (size_t k = begin; k < count; k++) {
+			const bool refValid = DeltaAxisScalar(pivotRef, ref.w[k], ref.x[k], ref.y[k], ref.z[k], axisSign,
+				out.refX[k], out.refY[k], out.refZ[k]);
+			const bool targetValid = DeltaAxisScalar(pivotTarget, target.w[k], target.x[k], target.y[k], target.z[k], axisSign,
+				out.targetX[k], out.targetY[k], out.targetZ[k]);
+			out.valid[k] = refValid && targetValid;
+		}
+	}
+
+#ifdef ROTATION_DELTA_AVX2
+	bool CpuSupportsAvx2() {
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+
+		// AVX must be present and the OS must preserve the YMM registers across context switches
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+	// Four lanes of DeltaAxisScalar, writing to out[k, k + 4). Returns the lane validity bits.
+	TARGET_AVX2 int DeltaAxisAvx2(
+		const double (&p)[4], const QuaternionLanes& q, size_t k, __m256d axisSign,
+		double* outX, double* outY, double* outZ
+	) {
+		const __m256d pw = _mm256_set1_pd(p[0]), px = _mm256_set1_pd(p[1]);
+		const __m256d py = _mm256_set1_pd(p[2]), pz = _mm256_set1_pd(p[3]);
+		const __m256d qw = _mm256_loadu_pd(q.w + k), qx = _mm256_loadu_pd(q.x + k);
+		const __m256d qy = _mm256_loadu_pd(q.y + k), qz = _mm256_loadu_pd(q.z + k);
+
+		const __m256d dw = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(
+			_mm256_mul_pd(pw, qw), _mm256_mul_pd(px, qx)), _mm256_mul_pd(py, qy)), _mm256_mul_pd(pz, qz));
+		const __m256d dx = _mm256_add_pd(
+			_mm256_sub_pd(_mm256_mul_pd(px, qw), _mm256_mul_pd(pw, qx)),
+			_mm256_sub_pd(_mm256_mul_pd(pz, qy), _mm256_mul_pd(py, qz)));
+		const __m256d dy = _mm256_add_pd(
+			_mm256_sub_pd(_mm256_mul_pd(py, qw), _mm256_mul_pd(pw, qy)),
+			_mm256_sub_pd(_mm256_mul_pd(px, qz), _mm256_mul_pd(pz, qx)));
+		const __m256d dz = _mm256_add_pd(
+			_mm256_sub_pd(_mm256_mul_pd(pz, qw), _mm256_mul_pd(pw, qz)),
+			_mm256_sub_pd(_mm256_mul_pd(py, qx), _mm256_mul_pd(px, qy)));
+
+		const __m256d vv = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz));
+		const __m256d ww = _mm256_mul_pd(dw, dw);
+
+		const __m256d flip = _mm256_cmp_pd(dw, _mm256_setzero_pd(), _CMP_LT_OQ);
+		const __m256d sign = _mm256_blendv_pd(axisSign, _mm256_sub_pd(_mm256_setzero_pd(), axisSign), flip);
+		const __m256d inv = _mm256_div_pd(sign, _mm256_sqrt_pd(vv));
+		_mm256_storeu_pd(outX + k, _mm256_mul_pd(dx, inv));
+		_mm256_storeu_pd(outY + k, _mm256_mul_pd(dy, inv));
+		_mm256_storeu_pd(outZ + k, _mm256_mul_pd(dz, inv));
+
+		const __m256d angleOk = _mm256_cmp_pd(vv, _mm256_mul_pd(_mm256_set1_pd(TanSqHalfMinAngle), ww), _CMP_GT_OQ);
+		const __m256d normOk = _mm256_cmp_pd(
+			_mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(16.0), vv), ww), _mm256_set1_pd(MinAxisNormSq), _CMP_GT_OQ);
+		return _mm256_movemask_pd(_mm256_and_pd(angleOk, normOk));
+	}
+
+	TARGET_AVX2 void ComputeRotationDeltasAvx2(
+		const double (&pivotRef)[4], const double (&pivotTarget)[4],
+		const QuaternionLanes& ref, const QuaternionLanes& target,
+		size_t count, double axisSign, RotationDeltaBatch& out
+	) {
+		const __m256d sign = _mm256_set1_pd(axisSign);
+
+		size_t k = 0;
+		for (; k + 4 <= count; k += 4) {
+			const int valid =
+				DeltaAxisAvx2(pivotRef, ref, k, sign, out.refX, out.refY, out.refZ) &
+				DeltaAxisAvx2(pivotTarget, target, k, sign, out.targetX, out.targetY, out.targetZ);
+
+			for (int lane = 0; lane < 4; lane++) {
+				out.valid[k + lane] = (valid >> lane) & 1;
+			}
+		}
+
+		ComputeRotationDeltasScalar(pivotRef, pivotTarget, ref, target, k, count, axisSign, out);
+	}
+#endif
+
+#ifdef ROTATION_DELTA_NEON
+	// Two lanes of DeltaAxisScalar, writing to out[k, k + 2). Returns the lane validity mask.
+	uint64x2_t DeltaAxisNeon(
+		const double (&p)[4], const QuaternionLanes& q, size_t k, float64x2_t axisSign,
+		double* outX, double* outY, double* outZ
+	) {
+		const float64x2_t pw = vdupq_n_f64(p[0]), px = vdupq_n_f64(p[1]);
+		const float64x2_t py = vdupq_n_f64(p[2]), pz = vdupq_n_f64(p[3]);
+		const float64x2_t qw = vld1q_f64(q.w + k), qx = vld1q_f64(q.x + k);
+		const float64x2_t qy = vld1q_f64(q.y + k), qz = vld1q_f64(q.z + k);
+
+		const float64x2_t dw = vaddq_f64(vaddq_f64(vaddq_f64(
+			vmulq_f64(pw, qw), vmulq_f64(px, qx)), vmulq_f64(py, qy)), vmulq_f64(pz, qz));
+		const float64x2_t dx = vaddq_f64(
+			vsubq_f64(vmulq_f64(px, qw), vmulq_f64(pw, qx)),
+			vsubq_f64(vmulq_f64(pz, qy), vmulq_f64(py, qz)));
+		const float64x2_t dy = vaddq_f64(
+			vsubq_f64(vmulq_f64(py, qw), vmulq_f64(pw, qy)),
+			vsubq_f64(vmulq_f64(px, qz), vmulq_f64(pz, qx)));
+		const float64x2_t dz = vaddq_f64(
+			vsubq_f64(vmulq_f64(pz, qw), vmulq_f64(pw, qz)),
+			vsubq_f64(vmulq_f64(py, qx), vmulq_f64(px, qy)));
+
+		const float64x2_t vv = vaddq_f64(vaddq_f64(vmulq_f64(dx, dx), vmulq_f64(dy, dy)), vmulq_f64(dz, dz));
+		const float64x2_t ww = vmulq_f64(dw, dw);
+
+		const uint64x2_t flip = vcltq_f64(dw, vdupq_n_f64(0.0));
+		const float64x2_t sign = vbslq_f64(flip, vnegq_f64(axisSign), axisSign);
+		const float64x2_t inv = vdivq_f64(sign, vsqrtq_f64(vv));
+		vst1q_f64(outX + k, vmulq_f64(dx, inv));
+		vst1q_f64(outY + k, vmulq_f64(dy, inv));
+		vst1q_f64(outZ + k, vmulq_f64(dz, inv));
+
+		const uint64x2_t angleOk = vcgtq_f64(vv, vmulq_f64(vdupq_n_f64(TanSqHalfMinAngle), ww));
+		const uint64x2_t normOk = vcgtq_f64(
+			vmulq_f64(vmulq_f64(vdupq_n_f64(16.0), vv), ww), vdupq_n_f64(MinAxisNormSq));
+		return vandq_u64(angleOk, normOk);
+	}
+
+	void ComputeRotationDeltasNeon(
+		const double (&pivotRef)[4], const double (&pivotTarget)[4],
+		const QuaternionLanes& ref, const QuaternionLanes& target,
+		size_t count, double axisSign, RotationDeltaBatch& out
+	) {
+		const float64x2_t sign = vdupq_n_f64(axisSign);
+
+		size_t k = 0;
+		for (; k + 2 <= count; k += 2) {
+			const uint64x2_t valid = vandq_u64(
+				DeltaAxisNeon(pivotRef, ref, k, sign, out.refX, out.refY, out.refZ),
+				DeltaAxisNeon(pivotTarget, target, k, sign, out.targetX, out.targetY, out.targetZ));
+
+			out.valid[k] = vgetq_lane_u64(valid, 0) != 0;
+			out.valid[k + 1] = vgetq_lane_u64(valid, 1) != 0;
+		}
+
+		ComputeRotationDeltasScalar(pivotRef, pivotTarget, ref, target, k, count, axisSign, out);
+	}
+#endif
+
+	void ComputeRotationDeltasFallback(
+		const double (&pivotRef)[4], const double (&pivotTarget)[4],
+		const QuaternionLanes& ref, const QuaternionLanes& target,
+		size_t count, double axisSign, RotationDeltaBatch& out
+	) {
+		ComputeRotationDeltasScalar(pivotRef, pivotTarget, ref, target, 0, count, axisSign, out);
+	}
+
+	struct Kernel {
+		decltype(&ComputeRotationDeltasFallback) fn;
+		const char* name;
+	};
+
+	Kernel SelectKernel() {
+#if defined(ROTATION_DELTA_AVX2)
+		if (CpuSupportsAvx2()) return { ComputeRotationDeltasAvx2, "AVX2" };
+#elif defined(ROTATION_DELTA_NEON)
+		// NEON is part of the ARMv8 baseline
+		return { ComputeRotationDeltasNeon, "NEON" };
+#endif
+		return { ComputeRotationDeltasFallback, "scalar" };
+	}
+
+	// Picked during static initialization, before any solver thread can call in.
+	const Kernel SelectedKernel = SelectKernel();
+}
+
+void ComputeRotationDeltas(
+	const double (&pivotRef)[4], const double (&pivotTarget)[4],
+	const QuaternionLanes& ref, const QuaternionLanes& target,
+	size_t count, double axisSign, RotationDeltaBatch& out
+) {
+	SelectedKernel.fn(pivotRef, pivotTarget, ref, target, count, axisSign, out);
+}
+
+const char* RotationDeltaKernelName() {
+	return SelectedKernel.name;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Batched rotation axis extraction for sample pairs, used by the rotation solve and outlier detection.
+ *
+ * Each sample's rotations are read as unit quaternions stored one component per array, so that a run of samples
+ * can be loaded a SIMD register at a time. For every sample k of the run, the kernel takes the relative rotation
+ * pivot * conj(q_k) of both devices and returns its unit axis, along with whether the pair moved far enough
+ * apart to give a usable axis.
+ *
+ * The AVX2 (x64) or NEON (ARM64) kernel is picked when available, with a scalar fallback otherwise. All variants
+ * evaluate the same expressions in the same order, so they agree with each other up to rounding.
+ */
+
+struct QuaternionLanes {
+	const double *w, *x, *y, *z;
+
+	QuaternionLanes Offset(size_t n) const { return { w + n, x + n, y + n, z + n }; }
+};
+
+struct RotationDeltaBatch {
+	static constexpr size_t Capacity = 64;
+
+	double refX[Capacity], refY[Capacity], refZ[Capacity];
+	double targetX[Capacity], targetY[Capacity], targetZ[Capacity];
+	uint8_t valid[Capacity];
+};
+
+/*
+ * Fills out[0, count) with the axes of the rotations from samples [0, count) of the lanes to the pivot, for
+ * count <= RotationDeltaBatch::Capacity. Pivots are (w, x, y, z). Axes are multiplied by axisSign, so passing -1
+ * gives the axes of the inverse rotations, from the pivot to each sample.
+ */
+void ComputeRotationDeltas(
+	const double (&pivotRef)[4], const double (&pivotTarget)[4],
+	const QuaternionLanes& ref, const QuaternionLanes& target,
+	size_t count, double axisSign, RotationDeltaBatch& out);
+
+// Name of the kernel picked for this CPU, for the debug log.
+const char* RotationDeltaKernelName();
@@ -0,0 +1,119 @@
+#include "SampleBuffer.h"
+#include "CalibrationCalc.h"
+
+#include <algorithm>
+
+namespace {
+	// Used when samples are pushed before anything was reserved.
+	const size_t MinCapacity = 16;
+
+	// Moves the ring contents of `data` to the front of a buffer of the new capacity, oldest first.
+	template<typename T>
+	void Unroll(std::vector<T>& data, size_t head, size_t size, size_t capacity) {
+		std::vector<T> unrolled(capacity);
+		for (size_t i = 0; i < size; i++) {
+			size_t slot = head + i;
+			if (slot >= data.size()) slot -= data.size();
+			unrolled[i] = data[slot];
+		}
+		data.swap(unrolled);
+	}
+}
+
+void SampleBuffer::Reserve(size_t capacity) {
+	if (capacity <= Capacity()) return;
+
+	Unroll(m_refRot, m_head, m_size, capacity);
+	Unroll(m_refTrans, m_head, m_size, capacity);
+	Unroll(m_targetRot, m_head, m_size, capacity);
+	Unroll(m_targetTrans, m_head, m_size, capacity);
+	for (int c = 0; c < 4; c++) {
+		Unroll(m_refQuat[c], m_head, m_size, capacity);
+		Unroll(m_targetQuat[c], m_head, m_size, capacity);
+	}
+	Unroll(m_timestamp, m_head, m_size, capacity);
+	Unroll(m_valid, m_head, m_size, capacity);
+	Unroll(m_sequence, m_head, m_size, capacity);
+	m_head = 0;
+}
+
+void SampleBuffer::Push(const Sample& sample) {
+	if (m_size == Capacity()) {
+		Reserve(std::max(MinCapacity, Capacity() * 2));
+	}
+
+	const size_t slot = Slot(m_size++);
+	m_refRot[slot] = sample.ref.rot;
+	m_refTrans[slot] = sample.ref.trans;
+	const Eigen::Quaterniond refQuat(sample.ref.rot);
+	m_refQuat[0][slot] = refQuat.w();
+	m_refQuat[1][slot] = refQuat.x();
+	m_refQuat[2][slot] = refQuat.y();
+	m_refQuat[3][slot] = refQuat.z();
+	m_targetRot[slot] = sample.target.rot;
+	m_targetTrans[slot] = sample.target.trans;
+	const Eigen::Quaterniond targetQuat(sample.target.rot);
+	m_targetQuat[0][slot] = targetQuat.w();
+	m_targetQuat[1][slot] = targetQuat.x();
+	m_targetQuat[2][slot] = targetQuat.y();
+	m_targetQuat[3][slot] = targetQuat.z();
+	m_timestamp[slot] = sample.timestamp;
+	m_valid[slot] = sample.valid;
+	m_sequence[slot] = m_nextSequence++;
+}
+
+void SampleBuffer::PopFront() {
+	if (m_size == 0) return;
+
+	m_head = Slot(1);
+	m_size--;
+}
+
+void SampleBuffer::Erase(size_t index) {
+	if (index >= m_size) return;
+
+	if (index < m_size / 2) {
+		for (size_t i = index; i > 0; i--) {
+			Move(Slot(i - 1), Slot(i));
+		}
+		PopFront();
+	} else {
+		for (size_t i = index + 1; i < m_size; i++) {
+			Move(Slot(i), Slot(i - 1));
+		}
+		m_size--;
+	}
+}
+
+void SampleBuffer::Move(size_t fromSlot, size_t toSlot) {
+	m_refRot[toSlot] = m_refRot[fromSlot];
+	m_refTrans[toSlot] = m_refTrans[fromSlot];
+	m_targetRot[toSlot] = m_targetRot[fromSlot];
+	m_targetTrans[toSlot] = m_targetTrans[fromSlot];
+	for (int c = 0; c < 4; c++) {
+		m_refQuat[c][toSlot] = m_refQuat[c][fromSlot];
+		m_targetQuat[c][toSlot] = m_targetQuat[c][fromSlot];
+	}
+	m_timestamp[toSlot] = m_timestamp[fromSlot];
+	m_valid[toSlot] = m_valid[fromSlot];
+	m_sequence[toSlot] = m_sequence[fromSlot];
+}
+
+void SampleBuffer::Clear() {
+	m_head = 0;
+	m_size = 0;
+	m_nextSequence = 0;
+}
+
+Sample SampleBuffer::At(size_t index) const {
+	const size_t slot = Slot(index);
+
+	Sample sample;
+	sample.ref.rot = m_refRot[slot];
+	sample.ref.trans = m_refTrans[slot];
+	sample.target.rot = m_targetRot[slot];
+	sample.target.trans = m_targetTrans[slot];
+	sample.timestamp = m_timestamp[slot];
+	sample.valid = m_valid[slot];
+	return sample;
+}
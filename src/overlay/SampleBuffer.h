@@ -0,0 +1,92 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "RotationDeltaKernel.h"
+
+struct Sample;
+
+/*
+ * Fixed-capacity ring of calibration samples, stored as one array per field.
+ *
+ * The solver kernels walk the window many times per solve and usually only need one or two fields of each
+ * sample, so keeping those fields contiguous lets them stream through memory instead of hopping between
+ * deque chunks. Quaternions are split further into one array per component for the batched rotation kernels.
+ * Pushing and popping only move the head and size; nothing is allocated once the capacity is reserved. Index 0
+ * is always the oldest sample in the window.
+ *
+ * Every pushed sample is numbered in sequence, so that it can be told apart from its neighbours even after
+ * samples in front of it have been removed.
+ */
+class SampleBuffer {
+public:
+	// Grows the ring to hold at least `capacity` samples, keeping its contents. Never shrinks.
+	void Reserve(size_t capacity);
+
+	// Appends a sample at the back. Should the ring be full, it grows rather than dropping samples, since the
+	// caller keeps running sums over the window that must see every eviction.
+	void Push(const Sample& sample);
+	void PopFront();
+	// Removes the sample at index, moving whichever side of the window is shorter to close the gap.
+	void Erase(size_t index);
+	void Clear();
+
+	size_t Size() const { return m_size; }
+	size_t Capacity() const { return m_refRot.size(); }
+	bool Empty() const { return m_size == 0; }
+
+	Sample At(size_t index) const;
+
+	const Eigen::Matrix3d& RefRot(size_t index) const { return m_refRot[Slot(index)]; }
+	const Eigen::Vector3d& RefTrans(size_t index) const { return m_refTrans[Slot(index)]; }
+	Eigen::Quaterniond RefQuat(size_t index) const { return Quat(m_refQuat, Slot(index)); }
+
+	const Eigen::Matrix3d& TargetRot(size_t index) const { return m_targetRot[Slot(index)]; }
+	const Eigen::Vector3d& TargetTrans(size_t index) const { return m_targetTrans[Slot(index)]; }
+	Eigen::Quaterniond TargetQuat(size_t index) const { return Quat(m_targetQuat, Slot(index)); }
+
+	double Timestamp(size_t index) const { return m_timestamp[Slot(index)]; }
+	bool Valid(size_t index) const { return m_valid[Slot(index)]; }
+	uint64_t Sequence(size_t index) const { return m_sequence[Slot(index)]; }
+
+	// Calls fn(index, count, refQuats, targetQuats) for each run of samples in [begin, end) that is contiguous in
+	// memory; there are at most two, as the ring may wrap around.
+	template<typename F>
+	void ForEachRun(size_t begin, size_t end, const F& fn) const {
+		while (begin < end) {
+			const size_t slot = Slot(begin);
+			const size_t count = std::min(end - begin, Capacity() - slot);
+			fn(begin, count, Lanes(m_refQuat, slot), Lanes(m_targetQuat, slot));
+			begin += count;
+		}
+	}
+
+private:
+	size_t Slot(size_t index) const {
+		const size_t slot = m_head + index;
+		return slot < Capacity() ? slot : slot - Capacity();
+	}
+
+	static Eigen::Quaterniond Quat(const std::vector<double> (&quat)[4], size_t slot) {
+		return Eigen::Quaterniond(quat[0][slot], quat[1][slot], quat[2][slot], quat[3][slot]);
+	}
+
+	static QuaternionLanes Lanes(const std::vector<double> (&quat)[4], size_t slot) {
+		return { quat[0].data() + slot, quat[1].data() + slot, quat[2].data() + slot, quat[3].data() + slot };
+	}
+
+	void Move(size_t fromSlot, size_t toSlot);
+
+	size_t m_head = 0;
+	size_t m_size = 0;
+	uint64_t m_nextSequence = 0;
+
+	std::vector<Eigen::Matrix3d> m_refRot, m_targetRot;
+	std::vector<Eigen::Vector3d> m_refTrans, m_targetTrans;
+	std::vector<double> m_refQuat[4], m_targetQuat[4]; // w, x, y, z
+	std::vector<double> m_timestamp;
+	std::vector<bool> m_valid;
+	std::vector<uint64_t> m_sequence;
+};
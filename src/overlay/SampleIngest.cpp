@@ -0,0 +1,82 @@
+#include "SampleIngest.h"
+
+#include <algorithm>
+
+// Turn (radians) and travel (meters) of the devices since the last admitted sample that each suffice to admit
+// the next one; smaller moves add up.
+static const double AdmitRotation = 0.05;
+static const double AdmitTranslation = 0.02;
+
+// Longest time without admitting a sample, in seconds. Holding still only repeats what the window already has, so
+// this only has to keep static recalibration solving about as often as it used to, without crowding out the
+// varied samples.
+static const double StillAdmitInterval = 1.0;
+
+namespace {
+	double AngleBetween(const Eigen::Matrix3d& a, const Eigen::Matrix3d& b) {
+		const double cosAngle = ((a * b.transpose()).trace() - 1.0) / 2.0;
+		return acos(std::min(std::max(cosAngle, -1.0), 1.0));
+	}
+}
+
+void SampleIngest::SetDevices(int referenceID, int targetID) {
+	if (referenceID == m_referenceID && targetID == m_targetID) return;
+
+	Clear();
+	m_referenceID = referenceID;
+	m_targetID = targetID;
+}
+
+void SampleIngest::Clear() {
+	m_reference.Clear();
+	m_target.Clear();
+	m_pairedUntil = -INFINITY;
+	m_lastAdmitted = Sample();
+}
+
+bool SampleIngest::Push(int deviceID, const TimedPose& pose) {
+	if (deviceID == m_targetID) return m_target.Push(pose);
+	if (deviceID == m_referenceID) return m_reference.Push(pose);
+	return false;
+}
+
+bool SampleIngest::NextPair(Sample& out) {
+	if (m_reference.Empty()) return false;
+	const double covered = m_reference.Latest().time;
+
+	// Oldest target pose that hasn't been paired yet; if the ring has wrapped past them all, start from its front.
+	size_t index = m_target.Find(m_pairedUntil);
+	index = index == PoseHistory::npos ? 0 : index + 1;
+
+	for (; index < m_target.Size(); index++) {
+		const TimedPose& target = m_target.At(index);
+		const double time = target.time - m_targetLatency;
+		if (time > covered) return false;
+
+		m_pairedUntil = target.time;
+
+		Pose reference;
+		if (target.valid && m_reference.Interpolate(time, reference)) {
+			out = Sample(reference, target.pose, time);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool SampleIngest::Admit(const Sample& sample) {
+	if (m_lastAdmitted.valid && sample.timestamp - m_lastAdmitted.timestamp < StillAdmitInterval) {
+		const double turned = std::max(
+			AngleBetween(sample.ref.rot, m_lastAdmitted.ref.rot),
+			AngleBetween(sample.target.rot, m_lastAdmitted.target.rot));
+		const double moved = std::max(
+			(sample.ref.trans - m_lastAdmitted.ref.trans).norm(),
+			(sample.target.trans - m_lastAdmitted.target.trans).norm());
+
+		if (turned / AdmitRotation + moved / AdmitTranslation < 1.0) return false;
+	}
+
+	m_lastAdmitted = sample;
+	return true;
+}
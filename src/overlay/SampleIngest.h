@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include "CalibrationCalc.h"
+#include "PoseHistory.h"
+
+/*
+ * Turns the raw pose stream of the reference and target devices into calibration samples.
+ *
+ * The driver reports each device's poses at its own rate (up to ~1 kHz), and the two devices' poses never line up
+ * in time. Both devices' poses are kept in a short PoseHistory, and every target pose is paired with the reference
+ * pose interpolated to exactly the same instant, once the reference history reaches past it. This removes the
+ * skew that pairing with "whatever the reference reported last" has while the devices move.
+ *
+ * Most of those pairs repeat what the window already knows, so Admit() decimates them by how far the devices
+ * have turned and moved since the last admitted sample. Waving the devices around fills the window quickly with
+ * well spread samples, while holding still only admits one sample per StillAdmitInterval, so that static
+ * recalibration keeps seeing fresh data without the window filling up with copies of the same pose.
+ */
+class SampleIngest {
+public:
+	// Pairs are only formed between the given devices; changing them drops any partial state.
+	void SetDevices(int referenceID, int targetID);
+	void Clear();
+
+	// Seconds by which the target's poses lag the reference's; target poses are paired at their time minus this.
+	void SetTargetLatency(double latency) { m_targetLatency = latency; }
+
+	/*
+	 * Feeds a pose of one of the two devices, and calls onPair(sample) for every reference/target pair that can
+	 * be formed now. Invalid poses should be passed too, with `valid` = false, so that no pair straddles a
+	 * tracking loss.
+	 */
+	template<typename F>
+	void Add(int deviceID, const TimedPose& pose, const F& onPair) {
+		if (!Push(deviceID, pose)) return;
+
+		Sample sample;
+		while (NextPair(sample)) {
+			onPair(sample);
+		}
+	}
+
+	// Whether a pair carries enough new information to go into the solver window.
+	bool Admit(const Sample& sample);
+
+private:
+	bool Push(int deviceID, const TimedPose& pose);
+	bool NextPair(Sample& out);
+
+	int m_referenceID = -1, m_targetID = -1;
+
+	PoseHistory m_reference, m_target;
+	double m_targetLatency = 0.0;
+
+	// Target poses up to this time have been paired (or skipped)
+	double m_pairedUntil = -INFINITY;
+
+	Sample m_lastAdmitted;
+};
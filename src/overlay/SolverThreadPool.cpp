@@ -0,0 +1,166 @@
+#include "SolverThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// Beyond this the pair loops are memory-bound and extra threads stop helping.
+	const size_t MaxWorkers = 7;
+}
+
+SolverThreadPool& SolverThreadPool::Get() {
+	static SolverThreadPool pool;
+	return pool;
+}
+
+SolverThreadPool::SolverThreadPool() {
+	// The calling thread takes blocks as well, so leave a core for it.
+	const size_t hardwareThreads = std::thread::hardware_concurrency();
+	const size_t workers = std::min(MaxWorkers, hardwareThreads > 1 ? hardwareThreads - 1 : 0);
+
+	for (size_t i = 0; i < workers; i++) {
+		m_workers.emplace_back([this]() { WorkerMain(); });
+	}
+}
+
+SolverThreadPool::~SolverThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_shutdown = true;
+	}
+	m_wake.notify_all();
+
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+}
+
+void SolverThreadPool::Run(size_t blocks, const std::function<void(size_t)>& task) {
+	// The pool runs one job at a time; callers on other threads queue up here.
+	std::lock_guard<std::mutex> runLock(m_runMutex);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = &task;
+		m_blocks = blocks;
+		m_nextBlock = 0;
+		m_pendingBlocks = blocks;
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	Drain(task, blocks);
+
+	// Wait for workers still inside the job too, so none of them can pick up blocks of the next one.
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this]() { return m_pendingBlocks == 0 && m_activeWorkers == 0; });
+	m_task = nullptr;
+}
+
+// Takes blocks off the current job until there are none left.
+void SolverThreadPool::Drain(const std::function<void(size_t)>& task, size_t blocks) {
+	size_t completed = 0;
+	for (size_t block = m_nextBlock++; block < blocks; block = m_nextBlock++) {
+		task(block);
+		completed++;
+	}
+
+	if (completed > 0) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pendingBlocks -= completed;
+	}
+}
+
+void SolverThreadPool::WorkerMain() {
+	uint64_t seenGeneration = 0;
+
+	for (;;) {
+		const std::function<void(size_t)>* task;
+		size_t blocks;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&]() { return m_shutdown || m_generation != seenGeneration; });
+			if (m_shutdown) return;
+
+			seenGeneration = m_generation;
+			task = m_task;
+			blocks = m_blocks;
+			if (!task) continue;
+
+			m_activeWorkers++;
+		}
+
+		Drain(*task, blocks);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_activeWorkers--;
+		}
+		m_done.notify_all();
+	}
+}
+
+std::array<size_t, SolverThreadPool::BlockCount + 1> PartitionRows(size_t rows, bool triangular) {
+	std::array<size_t, SolverThreadPool::BlockCount + 1> bounds;
+	const size_t blocks = SolverThreadPool::BlockCount;
+
+	for (size_t block = 0; block <= blocks; block++) {
+		const double fraction = block / (double)blocks;
+		// Rows [0, r) of a triangle hold r^2 / 2 pairs, so equal pair counts are at r = rows * sqrt(fraction).
+		const double boundary = triangular ? rows * std::sqrt(fraction) : rows * fraction;
+		bounds[block] = std::min(rows, (size_t)std::llround(boundary));
+	}
+	bounds[blocks] = rows;
+
+	return bounds;
+}
+
+std::array<size_t, SolverThreadPool::BlockCount + 1> PartitionRows(const std::vector<size_t>& order, bool triangular) {
+	std::array<size_t, SolverThreadPool::BlockCount + 1> bounds;
+	const size_t blocks = SolverThreadPool::BlockCount;
+
+	size_t total = 0;
+	for (size_t row : order) {
+		total += triangular ? row : 1;
+	}
+
+	// Cut wherever the running work count crosses the next multiple of total / blocks.
+	size_t block = 0, work = 0;
+	for (size_t k = 0; k < order.size(); k++) {
+		while (block < blocks && work * blocks >= block * total) {
+			bounds[block++] = k;
+		}
+		work += triangular ? order[k] : 1;
+	}
+	while (block <= blocks) {
+		bounds[block++] = order.size();
+	}
+
+	return bounds;
+}
+
+std::vector<size_t> StratifiedOrder(size_t rows) {
+	size_t bits = 0;
+	while (((size_t)1 << bits) < rows) bits++;
+
+	std::vector<size_t> order;
+	order.reserve(rows);
+
+	for (size_t k = 0; k < ((size_t)1 << bits); k++) {
+		size_t reversed = 0;
+		for (size_t bit = 0; bit < bits; bit++) {
+			reversed |= ((k >> bit) & 1) << (bits - 1 - bit);
+		}
+		if (reversed < rows) order.push_back(reversed);
+	}
+
+	return order;
+}
+
+SolveBudget::SolveBudget(double seconds) {
+	if (seconds <= 0) return;
+
+	m_bounded = true;
+	m_deadline = std::chrono::steady_clock::now()
+		+ std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+}
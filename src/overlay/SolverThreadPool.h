@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Small worker pool for the O(N^2) sample pair loops of the calibration solver.
+ *
+ * Work is always cut into the same fixed number of blocks, each reduced into its own accumulator, and the block
+ * results are combined in block order. The result therefore doesn't depend on how many threads ran or on which
+ * thread picked up which block, and is bit-identical to running the blocks inline.
+ */
+class SolverThreadPool {
+public:
+	static const size_t BlockCount = 64;
+
+	// The first call must not race with another: thread-safe statics are disabled in MSVC builds.
+	static SolverThreadPool& Get();
+
+	~SolverThreadPool();
+
+	size_t WorkerCount() const { return m_workers.size(); }
+
+	// Runs task(block) for every block in [0, blocks) on the pool and the calling thread, and waits for completion.
+	// Concurrent calls from several threads are serialized.
+	void Run(size_t blocks, const std::function<void(size_t)>& task);
+
+private:
+	SolverThreadPool();
+
+	void WorkerMain();
+	void Drain(const std::function<void(size_t)>& task, size_t blocks);
+
+	std::vector<std::thread> m_workers;
+
+	std::mutex m_runMutex;
+	std::mutex m_mutex;
+	std::condition_variable m_wake, m_done;
+	bool m_shutdown = false;
+	uint64_t m_generation = 0;
+
+	const std::function<void(size_t)>* m_task = nullptr;
+	size_t m_blocks = 0;
+	std::atomic<size_t> m_nextBlock = 0;
+	size_t m_pendingBlocks = 0;
+	size_t m_activeWorkers = 0;
+};
+
+/*
+ * Wall-clock budget for an anytime solve, and how much of the pair work the solve got through within it.
+ * A default-constructed budget never runs out.
+ */
+class SolveBudget {
+public:
+	SolveBudget() = default;
+	explicit SolveBudget(double seconds);
+
+	bool Bounded() const { return m_bounded; }
+	bool Expired() const { return m_bounded && std::chrono::steady_clock::now() >= m_deadline; }
+
+	// Records that a pair loop got through `done` of its `total` units of work.
+	void Account(size_t done, size_t total) {
+		if (total > 0) m_coverage = std::min(m_coverage, (double)done / (double)total);
+	}
+
+	// Smallest fraction of its work that any loop got through so far; 1 unless a loop was cut short.
+	double Coverage() const { return m_coverage; }
+
+private:
+	bool m_bounded = false;
+	std::chrono::steady_clock::time_point m_deadline;
+	double m_coverage = 1.0;
+};
+
+/*
+ * Splits rows [0, rows) into SolverThreadPool::BlockCount contiguous blocks. For triangular loops, where row i
+ * visits i pairs, the blocks are balanced by pair count rather than row count.
+ */
+std::array<size_t, SolverThreadPool::BlockCount + 1> PartitionRows(size_t rows, bool triangular);
+
+// Same as PartitionRows, for rows visited in the given order.
+std::array<size_t, SolverThreadPool::BlockCount + 1> PartitionRows(const std::vector<size_t>& order, bool triangular);
+
+/*
+ * Permutation of [0, rows) in bit-reversed (van der Corput) order: every prefix of it is spread close to evenly
+ * over the whole range.
+ */
+std::vector<size_t> StratifiedOrder(size_t rows);
+
+/*
+ * Reduces fn(accumulator, row) over rows [0, rows), where the rows visit `work` pairs in total. Acc must be
+ * default-constructible to its zero value and support +=. Small loops run inline, as waking the pool would cost
+ * more than it saves.
+ *
+ * Given a bounded budget, rows are visited in stratified order and the loop stops taking rows once the budget
+ * expires, so the result covers a subset of rows spread over the whole range. How far it got is accounted to
+ * the budget.
+ */
+template<typename Acc, typename F>
+Acc ReduceRows(size_t rows, bool triangular, size_t work, bool parallel, const F& fn, SolveBudget* budget = nullptr) {
+	static const size_t minParallelWork = 4096;
+
+	const bool bounded = budget && budget->Bounded();
+	const std::vector<size_t> order = bounded ? StratifiedOrder(rows) : std::vector<size_t>();
+	const auto bounds = bounded ? PartitionRows(order, triangular) : PartitionRows(rows, triangular);
+	std::array<Acc, SolverThreadPool::BlockCount> partial;
+	std::array<size_t, SolverThreadPool::BlockCount> done{};
+
+	const std::function<void(size_t)> task = [&](size_t block) {
+		for (size_t k = bounds[block]; k < bounds[block + 1]; k++) {
+			if (bounded && budget->Expired()) break;
+
+			const size_t row = bounded ? order[k] : k;
+			fn(partial[block], row);
+			done[block] += triangular ? row : 1;
+		}
+	};
+
+	if (parallel && work >= minParallelWork && SolverThreadPool::Get().WorkerCount() > 0) {
+		SolverThreadPool::Get().Run(SolverThreadPool::BlockCount, task);
+	} else {
+		for (size_t block = 0; block < SolverThreadPool::BlockCount; block++) {
+			task(block);
+		}
+	}
+
+	Acc result = partial[0];
+	for (size_t block = 1; block < SolverThreadPool::BlockCount; block++) {
+		result += partial[block];
+	}
+
+	if (bounded) {
+		size_t doneRows = 0;
+		for (size_t block = 0; block < SolverThreadPool::BlockCount; block++) {
+			doneRows += done[block];
+		}
+
+		// Triangular loops count pairs already; otherwise every row does the same share of the work.
+		const size_t rowWork = triangular || rows == 0 ? 1 : work / rows;
+		budget->Account(doneRows * rowWork, triangular ? work : rows * rowWork);
+	}
+	return result;
+}
+
+// Reduces over the pair triangle {(i, j) : j < i < n}, calling fn(accumulator, i) once per row.
+template<typename Acc, typename F>
+Acc ReduceTriangle(size_t n, bool parallel, const F& fn, SolveBudget* budget = nullptr) {
+	return ReduceRows<Acc>(n, true, n * (n - 1) / 2, parallel, fn, budget);
+}
@@ -0,0 +1,63 @@
+#include "SolverWorker.h"
+#include "SolverThreadPool.h"
+
+#include <chrono>
+
+SolverWorker::SolverWorker() {
+	// Solves fan out to the thread pool. Create it here, on the main thread, as thread-safe statics are disabled
+	// in MSVC builds; this also makes sure the pool outlives the worker.
+	SolverThreadPool::Get();
+
+	m_thread = std::thread([this]() { ThreadMain(); });
+}
+
+SolverWorker::~SolverWorker() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_shutdown = true;
+	}
+	m_wake.notify_all();
+
+	if (m_thread.joinable()) {
+		m_thread.join();
+	}
+}
+
+void SolverWorker::Submit(const CalibrationCalc& window, const Job& job) {
+	m_solved = window;
+	m_job = job;
+	m_discard = false;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_state.store(State::Queued, std::memory_order_release);
+	}
+	m_wake.notify_one();
+}
+
+void SolverWorker::ThreadMain() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true) {
+		m_wake.wait(lock, [this]() {
+			return m_shutdown || m_state.load(std::memory_order_acquire) == State::Queued;
+		});
+		if (m_shutdown) return;
+
+		lock.unlock();
+
+		const auto start = std::chrono::steady_clock::now();
+
+		bool lerp = false;
+		if (m_job.continuous) {
+			m_solved.ComputeIncremental(lerp, m_job.threshold, m_job.relPoseMaxError, m_job.ignoreOutliers);
+		} else {
+			m_solved.ComputeOneshot(m_job.ignoreOutliers);
+		}
+
+		m_duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		lock.lock();
+		m_state.store(State::Done, std::memory_order_release);
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "CalibrationCalc.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/*
+ * Runs calibration solves on a dedicated thread, so that a slow solve doesn't stall rendering, event polling or
+ * sample collection on the main thread.
+ *
+ * The main thread keeps collecting into its own CalibrationCalc. Submit() copies that window into the worker's
+ * buffer (reusing the buffer's storage, so this doesn't allocate once the window size has settled) and wakes the
+ * worker. The worker hands the solved copy back by flipping an atomic state flag, and the main thread picks it up
+ * with Collect(). Only one solve is in flight at a time.
+ */
+class SolverWorker {
+public:
+	struct Job {
+		bool continuous = false;
+		double threshold = 0.0;
+		double relPoseMaxError = 0.0;
+		bool ignoreOutliers = true;
+		// One-shot solve of a window that isn't full yet; only finishes the calibration if it has converged.
+		bool earlyStop = false;
+	};
+
+	SolverWorker();
+	~SolverWorker();
+
+	// True from Submit() until the result has been collected.
+	bool Busy() const { return m_state.load(std::memory_order_acquire) != State::Idle; }
+
+	// Starts solving a copy of the window. Only call while !Busy().
+	void Submit(const CalibrationCalc& window, const Job& job);
+
+	// Drops the result of the solve in flight, if any, e.g. because the calibration was restarted.
+	void Discard() { m_discard = Busy(); }
+
+	/*
+	 * If the solve has finished, calls fn(solved, job, seconds) on the calling thread with the solved copy of the
+	 * window, and makes the worker available for the next job. Returns whether a result was collected.
+	 */
+	template<typename F>
+	bool Collect(const F& fn) {
+		if (m_state.load(std::memory_order_acquire) != State::Done) return false;
+
+		if (!m_discard) {
+			fn(m_solved, m_job, m_duration);
+		}
+		m_discard = false;
+
+		m_state.store(State::Idle, std::memory_order_release);
+		return true;
+	}
+
+private:
+	enum class State {
+		Idle,
+		Queued,
+		Done,
+	};
+
+	void ThreadMain();
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_shutdown = false;
+
+	std::atomic<State> m_state = State::Idle;
+
+	// Owned by the main thread while Idle or Done, and by the worker while Queued.
+	CalibrationCalc m_solved;
+	Job m_job;
+	double m_duration = 0.0;
+
+	// Main thread only
+	bool m_discard = false;
+};
@@ -239,6 +239,10 @@ void RequestImmediateRedraw() {
 	immediateRedraw = true;
 }
 
+// Set while the driver wakes the loop up for new poses; the loop then only polls as a fallback.
+static bool poseWakeup;
+static const double poseWakeupFallbackInterval = 0.5;
+
 double lastFrameStartTime = glfwGetTime();
 void RunLoop() {
 	while (!glfwWindowShouldClose(glfwWindow))
@@ -396,6 +400,9 @@ void RunLoop() {
 		const double dashboardInterval = 1.0 / 90.0; // fps
 		double waitEventsTimeout = std::max(CalCtx.wantedUpdateInterval, dashboardInterval);
 
+		if (poseWakeup)
+			waitEventsTimeout = std::max(waitEventsTimeout, poseWakeupFallbackInterval);
+
 		if (dashboardVisible && waitEventsTimeout > dashboardInterval)
 			waitEventsTimeout = dashboardInterval;
 
@@ -484,7 +491,9 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
 		CreateGLFWWindow();
 		InitCalibrator();
 		LoadProfile(CalCtx);
+		poseWakeup = StartPoseWakeup();
 		RunLoop();
+		StopPoseWakeup();
 
 		vr::VR_Shutdown();
 
@@ -301,6 +301,45 @@ void CCal_DrawSettings() {
 			}
 			ImGui::PopID();
 
+			// Solve time budget
+			ImGui::Text("Solve time budget (ms)");
+			ImGui::SameLine();
+			ImGui::PushID("solve_budget");
+			ImGui::SliderFloat("##solve_budget_slider", &CalCtx.solveBudgetMs, 0.0f, 100.0f, "%1.0f", 0);
+			if (ImGui::IsItemHovered(0)) {
+				ImGui::SetTooltip("Caps how long each calibration solve may take. 0 means unlimited.\n"
+					"When a solve runs out of time it uses the sample pairs it got through, spread over the whole window;\n"
+					"if that is too few, the previous calibration is kept.");
+			}
+			ImGui::PopID();
+
+			// Continuous solver
+			ImGui::Text("Solver");
+			ImGui::SameLine();
+			if (ImGui::RadioButton("Closed form", CalCtx.continuousSolver == CalibrationContext::CLOSED_FORM)) {
+				CalCtx.continuousSolver = CalibrationContext::CLOSED_FORM;
+			}
+			if (ImGui::IsItemHovered(0)) {
+				ImGui::SetTooltip("Solves the calibration from scratch on every update.");
+			}
+			ImGui::SameLine();
+			if (ImGui::RadioButton("Refine", CalCtx.continuousSolver == CalibrationContext::REFINE)) {
+				CalCtx.continuousSolver = CalibrationContext::REFINE;
+			}
+			if (ImGui::IsItemHovered(0)) {
+				ImGui::SetTooltip("Refines the current calibration with a few iterations, which is much cheaper while it only drifts slowly.\n"
+					"Falls back to solving from scratch when the error jumps.");
+			}
+			ImGui::SameLine();
+			if (ImGui::RadioButton("Filter", CalCtx.continuousSolver == CalibrationContext::FILTER)) {
+				CalCtx.continuousSolver = CalibrationContext::FILTER;
+			}
+			if (ImGui::IsItemHovered(0)) {
+				ImGui::SetTooltip("Once a first calibration is solved, tracks it with a Kalman filter fed by every pose the driver reports,\n"
+					"instead of re-solving the sample window. Much cheaper, and reacts to drift without waiting for the window to refill.\n"
+					"Falls back to solving the window when the playspaces jump.");
+			}
+
 			ImGui::PushStyleColor(ImGuiCol_Text, ImGui::GetStyleColorVec4(ImGuiCol_TextDisabled));
 			ImGui::TextWrapped("Controls how often SpaceCalibrator synchronises playspaces.");
 			ImGui::PopStyleColor();
@@ -479,6 +518,24 @@ void CCal_BasicInfo() {
 	ImGui::SameLine();
 	ImGui::Checkbox("Require triggers", &CalCtx.requireTriggerPressToApply);
 	ImGui::Checkbox("Ignore outliers", &CalCtx.ignoreOutliers);
+	ImGui::SameLine();
+	ImGui::Checkbox("Multithreaded solver", &CalCtx.parallelSolver);
+	ImGui::SameLine();
+	ImGui::Checkbox("Compensate latency", &CalCtx.compensateLatency);
+	if (ImGui::IsItemHovered(0)) {
+		ImGui::SetTooltip("Predicts the target system's devices further ahead by how much later their poses arrive than the reference's\n"
+			"(currently %.1f ms, measured during calibration), so both move in step.", CalCtx.targetLatency * 1000.0);
+	}
+	ImGui::SameLine();
+	ImGui::Checkbox("Diverse samples", &CalCtx.coresetWindow);
+	if (ImGui::IsItemHovered(0)) {
+		ImGui::SetTooltip("Keeps the calibration samples spread over as many device orientations and positions as possible,\n"
+			"replacing near-duplicate poses instead of the oldest ones. Calibrating then only needs enough varied motion.");
+	}
+	if (Metrics::enableLogs) {
+		ImGui::SameLine();
+		ImGui::Checkbox("Debug: All-pairs solver", &CalCtx.allPairsSolver);
+	}
 
 	// Status field...
 